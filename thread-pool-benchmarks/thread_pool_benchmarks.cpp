@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.hpp"
+#include "task_group.hpp"
+
+// Benchmarks of ThreadPool - results are printed as CSV to stdout:
+//   benchmark,variant,threads,run,operations,time_ms,ops_per_s,p50_ns,p99_ns
+// Usage: thread-pool-benchmarks [no_of_runs]
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+struct Result
+{
+    string benchmark;
+    string variant;
+    size_t threads;
+    size_t operations;
+    Clock::duration time;
+    chrono::nanoseconds p50{-1}; // latency percentiles - negative if not measured
+    chrono::nanoseconds p99{-1};
+};
+
+void print_csv_header()
+{
+    cout << "benchmark,variant,threads,run,operations,time_ms,ops_per_s,p50_ns,p99_ns" << endl;
+}
+
+void print_csv(const Result& r, int run)
+{
+    auto time_ms = chrono::duration<double, milli>(r.time).count();
+    auto ops_per_s = r.operations / chrono::duration<double>(r.time).count();
+
+    cout << r.benchmark << "," << r.variant << "," << r.threads << "," << run << "," << r.operations << ","
+         << time_ms << "," << static_cast<long long>(ops_per_s) << ",";
+
+    if (r.p50.count() >= 0)
+        cout << r.p50.count() << "," << r.p99.count();
+    else
+        cout << ",";
+
+    cout << endl;
+}
+
+size_t no_of_threads()
+{
+    return max(thread::hardware_concurrency(), 1u);
+}
+
+///////////////////////////////////////////
+// latency of an empty task: submit -> get() in external thread
+
+Result submit_latency(size_t iterations)
+{
+    ThreadPool pool(no_of_threads());
+
+    vector<chrono::nanoseconds> latencies;
+    latencies.reserve(iterations);
+
+    auto start = Clock::now();
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        auto submitted = Clock::now();
+        pool.submit([] {}).get();
+        latencies.push_back(Clock::now() - submitted);
+    }
+    auto time = Clock::now() - start;
+
+    sort(latencies.begin(), latencies.end());
+
+    Result r{"submit_latency", "empty_task", pool.size(), iterations, time};
+    r.p50 = latencies[latencies.size() / 2];
+    r.p99 = latencies[latencies.size() * 99 / 100];
+    return r;
+}
+
+///////////////////////////////////////////
+// throughput of fire & forget tasks pushed by many submitters
+
+Result throughput(size_t no_of_submitters, size_t no_of_tasks)
+{
+    ThreadPool pool(no_of_threads());
+
+    atomic<size_t> counter{0};
+    promise<void> all_done;
+    const size_t tasks_per_submitter = no_of_tasks / no_of_submitters;
+    const size_t total = tasks_per_submitter * no_of_submitters;
+
+    auto task = [&] {
+        if (counter.fetch_add(1, memory_order_relaxed) + 1 == total)
+            all_done.set_value();
+    };
+
+    auto start = Clock::now();
+
+    vector<thread> submitters;
+    for(size_t i = 0; i < no_of_submitters; ++i)
+        submitters.emplace_back([&] {
+            for(size_t j = 0; j < tasks_per_submitter; ++j)
+                pool.execute(task);
+        });
+
+    for(auto& thd : submitters)
+        thd.join();
+
+    all_done.get_future().wait();
+    auto time = Clock::now() - start;
+
+    return Result{"throughput", to_string(no_of_submitters) + "_submitters", pool.size(), total, time};
+}
+
+///////////////////////////////////////////
+// fan-out of many tasks & fan-in with futures
+
+Result fan_out_fan_in(size_t no_of_tasks)
+{
+    ThreadPool pool(no_of_threads());
+
+    vector<TaskFuture<size_t>> results;
+    results.reserve(no_of_tasks);
+
+    auto start = Clock::now();
+
+    for(size_t i = 0; i < no_of_tasks; ++i)
+        results.push_back(pool.submit([i] { return i; }));
+
+    size_t sum = 0;
+    for(auto& r : results)
+        sum += r.get();
+
+    auto time = Clock::now() - start;
+
+    if (sum != no_of_tasks * (no_of_tasks - 1) / 2)
+        cerr << "fan_out_fan_in: wrong result" << endl;
+
+    return Result{"fan_out_fan_in", "futures", pool.size(), no_of_tasks, time};
+}
+
+Result fan_out_fan_in_bulk(size_t no_of_tasks)
+{
+    ThreadPool pool(no_of_threads());
+
+    vector<size_t> results(no_of_tasks);
+
+    auto start = Clock::now();
+
+    pool.submit_n(no_of_tasks, [&results](size_t i) { results[i] = i; }).get();
+
+    size_t sum = 0;
+    for(auto r : results)
+        sum += r;
+
+    auto time = Clock::now() - start;
+
+    if (sum != no_of_tasks * (no_of_tasks - 1) / 2)
+        cerr << "fan_out_fan_in_bulk: wrong result" << endl;
+
+    return Result{"fan_out_fan_in", "submit_n", pool.size(), no_of_tasks, time};
+}
+
+///////////////////////////////////////////
+// recursive fork-join - every call of fib above the cutoff spawns a task
+// - the cutoff bounds nesting of tasks executed by waiting workers (FIFO queue - not a work-stealing deque)
+
+long fib(int n)
+{
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+long parallel_fib(ThreadPool& pool, int n, int cutoff)
+{
+    if (n <= cutoff)
+        return fib(n);
+
+    long x, y;
+
+    TaskGroup tg{pool};
+    tg.run([&] { x = parallel_fib(pool, n - 1, cutoff); });
+    y = parallel_fib(pool, n - 2, cutoff);
+    tg.wait();
+
+    return x + y;
+}
+
+Result fork_join_fib(int n, int cutoff)
+{
+    ThreadPool pool(no_of_threads());
+
+    auto start = Clock::now();
+    long result = parallel_fib(pool, n, cutoff);
+    auto time = Clock::now() - start;
+
+    if (result != fib(n))
+        cerr << "fork_join_fib: wrong result" << endl;
+
+    // a task is spawned by every call with n > cutoff
+    size_t no_of_tasks = static_cast<size_t>(fib(n - cutoff + 2) - 1);
+
+    return Result{"fork_join_fib", "fib(" + to_string(n) + ")_cutoff_" + to_string(cutoff), pool.size(), no_of_tasks, time};
+}
+
+///////////////////////////////////////////
+// ThreadPool vs std::async - the same chunked work
+
+long work(size_t chunk)
+{
+    long sum = 0;
+    for(size_t i = 0; i < 10'000; ++i)
+        sum += static_cast<long>((i * chunk) % 7);
+    return sum;
+}
+
+Result async_comparison(size_t no_of_tasks)
+{
+    vector<future<long>> results;
+    results.reserve(no_of_tasks);
+
+    auto start = Clock::now();
+
+    for(size_t i = 0; i < no_of_tasks; ++i)
+        results.push_back(async(launch::async, work, i));
+
+    long sum = 0;
+    for(auto& r : results)
+        sum += r.get();
+
+    auto time = Clock::now() - start;
+
+    if (sum < 0)
+        cerr << "async: wrong result" << endl;
+
+    return Result{"async_comparison", "std_async", no_of_tasks, no_of_tasks, time};
+}
+
+Result pool_comparison(size_t no_of_tasks)
+{
+    ThreadPool pool(no_of_threads());
+
+    vector<TaskFuture<long>> results;
+    results.reserve(no_of_tasks);
+
+    auto start = Clock::now();
+
+    for(size_t i = 0; i < no_of_tasks; ++i)
+        results.push_back(pool.submit([i] { return work(i); }));
+
+    long sum = 0;
+    for(auto& r : results)
+        sum += r.get();
+
+    auto time = Clock::now() - start;
+
+    if (sum < 0)
+        cerr << "pool: wrong result" << endl;
+
+    return Result{"async_comparison", "thread_pool", pool.size(), no_of_tasks, time};
+}
+
+int main(int argc, char* argv[])
+{
+    const int no_of_runs = argc > 1 ? atoi(argv[1]) : 3;
+
+    print_csv_header();
+
+    for(int run = 1; run <= no_of_runs; ++run)
+    {
+        print_csv(submit_latency(10'000), run);
+
+        print_csv(throughput(1, 1'000'000), run);
+        print_csv(throughput(no_of_threads(), 1'000'000), run);
+
+        print_csv(fan_out_fan_in(1'000'000), run);
+        print_csv(fan_out_fan_in_bulk(1'000'000), run);
+
+        print_csv(fork_join_fib(30, 10), run);
+
+        print_csv(async_comparison(1'000), run);
+        print_csv(pool_comparison(1'000), run);
+    }
+}
@@ -0,0 +1,517 @@
+#ifndef ASYNC_FILE_IO_HPP
+#define ASYNC_FILE_IO_HPP
+
+// POSIX only - pread/pwrite & file descriptors
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define ASYNC_FILE_IO_URING 1
+#endif
+#endif
+
+#include "thread_pool.hpp"
+
+// completion handler of a file operation - result is the number of transferred bytes
+using IoHandler = std::function<void(std::error_code, size_t)>;
+
+namespace details
+{
+    enum class IoOpcode
+    {
+        read,
+        write
+    };
+
+    // the most bytes Linux transfers by one read/write (MAX_RW_COUNT) - fits in 32-bit length of io_uring
+    constexpr size_t max_io_size = 0x7ffff000;
+
+    struct IoRequest
+    {
+        IoOpcode opcode;
+        int fd;
+        void* buffer;
+        size_t size;
+        off_t offset;
+        IoHandler handler;
+    };
+
+#if defined(ASYNC_FILE_IO_URING)
+    // Minimal io_uring on raw system calls (no liburing)
+    // - one submission lock; completions are reaped by a single thread
+    // - requests above the ring capacity wait in a backlog, so submitting never blocks
+    class IoUring
+    {
+        int ring_fd_ = -1;
+        void* sq_ptr_ = MAP_FAILED;
+        void* cq_ptr_ = MAP_FAILED;
+        size_t sq_size_ = 0;
+        size_t cq_size_ = 0;
+        io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+        size_t sqes_size_ = 0;
+
+        std::atomic<unsigned>* sq_head_ = nullptr;
+        std::atomic<unsigned>* sq_tail_ = nullptr;
+        unsigned sq_mask_ = 0;
+        unsigned* sq_array_ = nullptr;
+        std::atomic<unsigned>* cq_head_ = nullptr;
+        std::atomic<unsigned>* cq_tail_ = nullptr;
+        unsigned cq_mask_ = 0;
+        io_uring_cqe* cqes_ = nullptr;
+        unsigned capacity_ = 0;
+
+        static int setup(unsigned entries, io_uring_params& params)
+        {
+            return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        }
+
+        int enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+        {
+            return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags, nullptr, 0));
+        }
+
+        static void* map_ring(int fd, size_t size, off_t offset)
+        {
+            return ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        }
+
+        // IORING_OP_READ & IORING_OP_WRITE require Linux 5.6
+        bool supports_read_write()
+        {
+            const size_t probe_size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+            std::unique_ptr<char[]> buffer{new char[probe_size]()};
+            auto* probe = reinterpret_cast<io_uring_probe*>(buffer.get());
+
+            if (::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe, 256) < 0)
+                return false;
+
+            auto is_supported = [probe](unsigned op) {
+                return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+            };
+
+            return is_supported(IORING_OP_READ) && is_supported(IORING_OP_WRITE) && is_supported(IORING_OP_NOP);
+        }
+
+        template <typename T>
+        T* at(void* base, unsigned offset)
+        {
+            return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+        }
+
+    public:
+        IoUring() = default;
+        IoUring(const IoUring&) = delete;
+        IoUring& operator=(const IoUring&) = delete;
+
+        ~IoUring()
+        {
+            if (sqes_ != MAP_FAILED)
+                ::munmap(sqes_, sqes_size_);
+            if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+                ::munmap(cq_ptr_, cq_size_);
+            if (sq_ptr_ != MAP_FAILED)
+                ::munmap(sq_ptr_, sq_size_);
+            if (ring_fd_ >= 0)
+                ::close(ring_fd_);
+        }
+
+        // false if io_uring is not available (old kernel, seccomp, disabled by sysctl)
+        bool init(unsigned entries)
+        {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+
+            ring_fd_ = setup(entries, params);
+            if (ring_fd_ < 0 || !supports_read_write())
+                return false;
+
+            sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+                sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+
+            sq_ptr_ = map_ring(ring_fd_, sq_size_, IORING_OFF_SQ_RING);
+            if (sq_ptr_ == MAP_FAILED)
+                return false;
+
+            cq_ptr_ = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_ptr_ : map_ring(ring_fd_, cq_size_, IORING_OFF_CQ_RING);
+            if (cq_ptr_ == MAP_FAILED)
+                return false;
+
+            sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+            sqes_ = static_cast<io_uring_sqe*>(map_ring(ring_fd_, sqes_size_, IORING_OFF_SQES));
+            if (sqes_ == MAP_FAILED)
+                return false;
+
+            // ring indexes are shared with the kernel - accessed as atomics
+            sq_head_ = at<std::atomic<unsigned>>(sq_ptr_, params.sq_off.head);
+            sq_tail_ = at<std::atomic<unsigned>>(sq_ptr_, params.sq_off.tail);
+            sq_mask_ = *at<unsigned>(sq_ptr_, params.sq_off.ring_mask);
+            sq_array_ = at<unsigned>(sq_ptr_, params.sq_off.array);
+            cq_head_ = at<std::atomic<unsigned>>(cq_ptr_, params.cq_off.head);
+            cq_tail_ = at<std::atomic<unsigned>>(cq_ptr_, params.cq_off.tail);
+            cq_mask_ = *at<unsigned>(cq_ptr_, params.cq_off.ring_mask);
+            cqes_ = at<io_uring_cqe>(cq_ptr_, params.cq_off.cqes);
+
+            // in-flight requests are limited by the smaller ring - completion queue cannot overflow
+            capacity_ = std::min(params.sq_entries, params.cq_entries);
+            return true;
+        }
+
+        unsigned capacity() const
+        {
+            return capacity_;
+        }
+
+        // called with submission lock - user_data 0 is a wake-up of the completion thread
+        // - on error the entry is withdrawn from the ring (kernel did not consume it)
+        std::error_code submit(const IoRequest* request)
+        {
+            const unsigned tail = sq_tail_->load(std::memory_order_relaxed);
+            const unsigned index = tail & sq_mask_;
+            assert(tail - sq_head_->load(std::memory_order_acquire) <= sq_mask_);
+
+            io_uring_sqe& sqe = sqes_[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+
+            if (request)
+            {
+                sqe.opcode = request->opcode == IoOpcode::read ? IORING_OP_READ : IORING_OP_WRITE;
+                sqe.fd = request->fd;
+                sqe.addr = reinterpret_cast<uint64_t>(request->buffer);
+                assert(request->size <= max_io_size);
+                sqe.len = static_cast<uint32_t>(request->size);
+                sqe.off = static_cast<uint64_t>(request->offset);
+            }
+            else
+                sqe.opcode = IORING_OP_NOP;
+
+            sqe.user_data = reinterpret_cast<uint64_t>(request);
+
+            sq_array_[index] = index;
+            sq_tail_->store(tail + 1, std::memory_order_release);
+
+            int res;
+            while ((res = enter(1, 0, 0)) < 0 && errno == EINTR)
+                ;
+
+            if (res < 0)
+            {
+                std::error_code ec{errno, std::system_category()};
+                sq_tail_->store(tail, std::memory_order_release);
+                return ec;
+            }
+
+            return {};
+        }
+
+        // blocks until at least one completion - calls f(user_data, res) for each of them
+        template <typename F>
+        void reap(F f)
+        {
+            unsigned head = cq_head_->load(std::memory_order_relaxed);
+
+            if (head == cq_tail_->load(std::memory_order_acquire))
+                enter(0, 1, IORING_ENTER_GETEVENTS);
+
+            const unsigned tail = cq_tail_->load(std::memory_order_acquire);
+            for(; head != tail; ++head)
+            {
+                const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                f(cqe.user_data, cqe.res);
+            }
+
+            cq_head_->store(head, std::memory_order_release);
+        }
+    };
+#endif
+}
+
+// Asynchronous reads & writes of files completed on a ThreadPool
+// - Linux: requests are submitted to io_uring without blocking; one thread reaps completions
+//   and hands them to workers, so a few threads sustain thousands of concurrent operations
+// - fallback (no io_uring): pread/pwrite in blocking regions of the pool - blocked workers are compensated
+// - handlers & futures are completed on workers of the pool - after its shutdown in the completing thread
+// - buffers must stay valid until completion; short reads/writes are reported as they are
+// - at most details::max_io_size bytes are transferred by one operation (as by read/write of Linux)
+// - a failed submission to io_uring is reported to the handler
+// - must be destroyed before the pool - the destructor waits for operations in flight
+class AsyncFileIO
+{
+    using IoRequest = details::IoRequest;
+    using IoOpcode = details::IoOpcode;
+
+    ThreadPool& pool_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_idle_;
+    size_t in_flight_ = 0;
+    bool is_stopping_ = false;
+
+#if defined(ASYNC_FILE_IO_URING)
+    std::unique_ptr<details::IoUring> ring_;
+    std::deque<std::unique_ptr<IoRequest>> backlog_; // waits for free slots of the ring
+    unsigned submitted_ = 0;
+    std::thread completion_thread_;
+
+    using FailedRequests = std::vector<std::pair<std::unique_ptr<IoRequest>, std::error_code>>;
+
+    // called with mtx_ locked - requests refused by the ring are completed by the caller after unlocking
+    void submit_to_ring(std::unique_ptr<IoRequest> request, FailedRequests& failed)
+    {
+        if (auto ec = ring_->submit(request.get()))
+        {
+            failed.emplace_back(std::move(request), ec);
+            return;
+        }
+
+        request.release(); // owned by the ring until its completion is reaped
+        ++submitted_;
+    }
+
+    void complete_failed(FailedRequests& failed)
+    {
+        for(auto& request : failed)
+            complete(std::move(request.first), request.second, 0);
+    }
+
+    void reap_completions()
+    {
+        while (true)
+        {
+            bool is_stopped = false;
+
+            ring_->reap([this, &is_stopped](uint64_t user_data, int res) {
+                if (user_data == 0)
+                {
+                    is_stopped = true;
+                    return;
+                }
+
+                std::unique_ptr<IoRequest> request{reinterpret_cast<IoRequest*>(user_data)};
+                FailedRequests failed;
+                {
+                    // the request was submitted with the lock held - locking it orders its fields before the reads below
+                    std::lock_guard<std::mutex> lk{mtx_};
+                    --submitted_;
+                    while (submitted_ < ring_->capacity() && !backlog_.empty()) // failed submissions free their slots
+                    {
+                        auto next = std::move(backlog_.front());
+                        backlog_.pop_front();
+                        submit_to_ring(std::move(next), failed);
+                    }
+                }
+                complete_failed(failed);
+
+                std::error_code ec;
+                size_t size = 0;
+                if (res < 0)
+                    ec = std::error_code{-res, std::system_category()};
+                else
+                    size = static_cast<size_t>(res);
+
+                complete(std::move(request), ec, size);
+            });
+
+            if (is_stopped)
+                return;
+        }
+    }
+#endif
+
+    // in_flight_ is decremented after the handler - also when it throws
+    void finish(const IoHandler& handler, std::error_code ec, size_t size)
+    {
+        struct InFlightGuard
+        {
+            AsyncFileIO& io;
+
+            ~InFlightGuard()
+            {
+                std::lock_guard<std::mutex> lk{io.mtx_};
+                if (--io.in_flight_ == 0)
+                    io.cv_idle_.notify_all();
+            }
+        } guard{*this};
+
+        handler(ec, size);
+    }
+
+    // handler runs on a worker - after shutdown of the pool in the calling thread, which must not hold mtx_
+    void complete(std::shared_ptr<IoRequest> request, std::error_code ec, size_t size)
+    {
+        if (!pool_.try_execute([this, request, ec, size] { finish(request->handler, ec, size); }))
+            finish(request->handler, ec, size);
+    }
+
+    // after shutdown of the pool the operation runs in the calling thread
+    void run_blocking(std::unique_ptr<IoRequest> request)
+    {
+        auto operation = [this, request = std::shared_ptr<IoRequest>{std::move(request)}] {
+            ssize_t res;
+            {
+                auto region = pool_.blocking_region();
+
+                do
+                {
+                    res = request->opcode == IoOpcode::read ? ::pread(request->fd, request->buffer, request->size, request->offset)
+                                                            : ::pwrite(request->fd, request->buffer, request->size, request->offset);
+                } while (res < 0 && errno == EINTR);
+            }
+
+            std::error_code ec;
+            if (res < 0)
+                ec = std::error_code{errno, std::system_category()};
+
+            finish(request->handler, ec, res < 0 ? 0 : static_cast<size_t>(res));
+        };
+
+        if (!pool_.try_execute(operation))
+            operation();
+    }
+
+    void start(std::unique_ptr<IoRequest> request)
+    {
+        assert(request->handler != nullptr);
+
+        if (request->size > details::max_io_size)
+            request->size = details::max_io_size;
+
+        std::unique_lock<std::mutex> lk{mtx_};
+        assert(!is_stopping_);
+        ++in_flight_;
+
+#if defined(ASYNC_FILE_IO_URING)
+        if (ring_)
+        {
+            FailedRequests failed;
+            if (submitted_ < ring_->capacity())
+                submit_to_ring(std::move(request), failed);
+            else
+                backlog_.push_back(std::move(request));
+
+            lk.unlock();
+            complete_failed(failed);
+            return;
+        }
+#endif
+
+        lk.unlock();
+        run_blocking(std::move(request));
+    }
+
+    template <typename Buffer>
+    TaskFuture<size_t> start_future(IoOpcode opcode, int fd, Buffer buffer, size_t size, off_t offset)
+    {
+        auto promise = std::make_shared<std::promise<size_t>>();
+        TaskFuture<size_t> f{promise->get_future(), pool_};
+
+        start(std::unique_ptr<IoRequest>{new IoRequest{opcode, fd, const_cast<void*>(static_cast<const void*>(buffer)), size, offset,
+            [promise](std::error_code ec, size_t transferred) {
+                if (ec)
+                    promise->set_exception(std::make_exception_ptr(std::system_error{ec}));
+                else
+                    promise->set_value(transferred);
+            }}});
+
+        return f;
+    }
+
+public:
+    // queue_depth - maximum number of operations submitted to io_uring at once
+    explicit AsyncFileIO(ThreadPool& pool, unsigned queue_depth = 256) : pool_{pool}
+    {
+#if defined(ASYNC_FILE_IO_URING)
+        auto ring = std::make_unique<details::IoUring>();
+        if (ring->init(queue_depth))
+        {
+            ring_ = std::move(ring);
+            completion_thread_ = std::thread{[this] { reap_completions(); }};
+        }
+#else
+        (void)queue_depth;
+#endif
+    }
+
+    AsyncFileIO(const AsyncFileIO&) = delete;
+    AsyncFileIO& operator=(const AsyncFileIO&) = delete;
+
+    ~AsyncFileIO()
+    {
+        std::unique_lock<std::mutex> lk{mtx_};
+        is_stopping_ = true;
+        cv_idle_.wait(lk, [this] { return in_flight_ == 0; });
+
+#if defined(ASYNC_FILE_IO_URING)
+        if (ring_)
+        {
+            // stops the completion thread - submission fails only transiently (EAGAIN, EBUSY) with an empty ring
+            while (ring_->submit(nullptr))
+                std::this_thread::yield();
+            lk.unlock();
+            completion_thread_.join();
+        }
+#endif
+    }
+
+    // true if operations are executed by io_uring (not by blocking workers)
+    bool uses_io_uring() const
+    {
+#if defined(ASYNC_FILE_IO_URING)
+        return ring_ != nullptr;
+#else
+        return false;
+#endif
+    }
+
+    // handler(error, bytes_read) is executed by a worker of the pool
+    void async_read(int fd, void* buffer, size_t size, off_t offset, IoHandler handler)
+    {
+        start(std::unique_ptr<IoRequest>{new IoRequest{IoOpcode::read, fd, buffer, size, offset, std::move(handler)}});
+    }
+
+    // handler(error, bytes_written) is executed by a worker of the pool
+    void async_write(int fd, const void* buffer, size_t size, off_t offset, IoHandler handler)
+    {
+        start(std::unique_ptr<IoRequest>{new IoRequest{IoOpcode::write, fd, const_cast<void*>(buffer), size, offset, std::move(handler)}});
+    }
+
+    // future of bytes read - std::system_error on failure
+    TaskFuture<size_t> read(int fd, void* buffer, size_t size, off_t offset)
+    {
+        return start_future(IoOpcode::read, fd, buffer, size, offset);
+    }
+
+    // future of bytes written - std::system_error on failure
+    TaskFuture<size_t> write(int fd, const void* buffer, size_t size, off_t offset)
+    {
+        return start_future(IoOpcode::write, fd, buffer, size, offset);
+    }
+};
+
+#endif
+
+#endif // ASYNC_FILE_IO_HPP
@@ -0,0 +1,87 @@
+#ifndef CODEL_HPP
+#define CODEL_HPP
+
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+// CoDel (Controlled Delay) decision of load shedding - based on RFC 8289
+// - sojourn time of dequeued items is compared with target
+// - when it stays above target for a whole interval, items are dropped
+//   with intervals shrinking as interval / sqrt(count), until sojourn time falls below target
+class CoDel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    const Clock::duration target_;
+    const Clock::duration interval_;
+    Clock::time_point first_above_time_{}; // epoch - sojourn time is below target
+    Clock::time_point drop_next_{};
+    size_t drop_count_ = 0;
+    bool is_dropping_ = false;
+    std::mutex mtx_;
+
+    Clock::time_point control_law(Clock::time_point t) const
+    {
+        auto interval = std::chrono::duration<double, Clock::period>(interval_) / std::sqrt(static_cast<double>(drop_count_));
+        return t + std::chrono::duration_cast<Clock::duration>(interval);
+    }
+
+    bool is_above_target(Clock::duration sojourn_time, Clock::time_point now, bool is_queue_empty)
+    {
+        if (sojourn_time < target_ || is_queue_empty)
+        {
+            first_above_time_ = Clock::time_point{};
+            return false;
+        }
+
+        if (first_above_time_ == Clock::time_point{})
+        {
+            first_above_time_ = now + interval_;
+            return false;
+        }
+
+        return now >= first_above_time_;
+    }
+
+public:
+    CoDel(Clock::duration target, Clock::duration interval) : target_{target}, interval_{interval}
+    {}
+
+    // called for a dequeued item - true if it should be dropped
+    bool should_drop(Clock::duration sojourn_time, Clock::time_point now, bool is_queue_empty)
+    {
+        std::lock_guard<std::mutex> lk{mtx_};
+
+        bool ok_to_drop = is_above_target(sojourn_time, now, is_queue_empty);
+
+        if (is_dropping_)
+        {
+            if (!ok_to_drop)
+            {
+                is_dropping_ = false;
+                return false;
+            }
+
+            if (now < drop_next_)
+                return false;
+
+            ++drop_count_;
+            drop_next_ = control_law(drop_next_);
+            return true;
+        }
+
+        if (!ok_to_drop)
+            return false;
+
+        // dropping state was left recently - continue with similar drop rate
+        is_dropping_ = true;
+        drop_count_ = (drop_count_ > 2 && now - drop_next_ < 16 * interval_) ? drop_count_ - 2 : 1;
+        drop_next_ = control_law(now);
+        return true;
+    }
+};
+
+#endif // CODEL_HPP
@@ -0,0 +1,401 @@
+#ifndef CORO_TASK_HPP
+#define CORO_TASK_HPP
+
+// requires C++20 - see THREAD_POOL_COROUTINES option in CMakeLists.txt
+
+#include <array>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "thread_pool.hpp"
+
+namespace coro
+{
+    // thread-local free lists of coroutine frames grouped in 64 byte size classes
+    // - a frame released on other thread goes to the free list of that thread
+    // - a list keeps at most max_free_frames frames - with producer/consumer threads the surplus is deallocated
+    class FramePool
+    {
+        static constexpr size_t granularity = 64;
+        static constexpr size_t no_of_classes = 16; // larger frames use global operator new
+        static constexpr size_t header_size = alignof(std::max_align_t); // keeps frames aligned like operator new
+        static constexpr size_t max_free_frames = 256; // per size class & thread
+
+        struct FreeBlock
+        {
+            FreeBlock* next;
+        };
+
+        struct FreeLists
+        {
+            std::array<FreeBlock*, no_of_classes> heads{};
+            std::array<size_t, no_of_classes> sizes{};
+
+            ~FreeLists()
+            {
+                for(auto head : heads)
+                {
+                    while (head)
+                        ::operator delete(std::exchange(head, head->next));
+                }
+            }
+        };
+
+        static FreeLists& free_lists()
+        {
+            static thread_local FreeLists lists;
+            return lists;
+        }
+
+        static size_t size_class(size_t size)
+        {
+            return (size + header_size + granularity - 1) / granularity - 1;
+        }
+
+    public:
+        // size class of the block is stored in front of the frame
+        static void* allocate(size_t size)
+        {
+            const size_t cls = size_class(size);
+            auto& lists = free_lists();
+            void* block = nullptr;
+
+            if (cls < no_of_classes && lists.heads[cls])
+            {
+                block = std::exchange(lists.heads[cls], lists.heads[cls]->next);
+                --lists.sizes[cls];
+            }
+            else
+            {
+                block = ::operator new(cls < no_of_classes ? (cls + 1) * granularity : size + header_size);
+            }
+
+            *static_cast<size_t*>(block) = cls;
+            return static_cast<char*>(block) + header_size;
+        }
+
+        static void deallocate(void* frame) noexcept
+        {
+            void* block = static_cast<char*>(frame) - header_size;
+            const size_t cls = *static_cast<size_t*>(block);
+            auto& lists = free_lists();
+
+            if (cls >= no_of_classes || lists.sizes[cls] == max_free_frames)
+            {
+                ::operator delete(block);
+                return;
+            }
+
+            lists.heads[cls] = ::new (block) FreeBlock{lists.heads[cls]};
+            ++lists.sizes[cls];
+        }
+    };
+
+    template <typename T>
+    class task;
+
+    namespace details
+    {
+        class PromiseBase
+        {
+            std::coroutine_handle<> continuation_ = std::noop_coroutine();
+            std::exception_ptr exception_;
+
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                // symmetric transfer - awaiting coroutine is resumed on the same worker
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+                {
+                    return h.promise().continuation_;
+                }
+
+                void await_resume() noexcept
+                {}
+            };
+
+        public:
+            static void* operator new(size_t size)
+            {
+                return FramePool::allocate(size);
+            }
+
+            static void operator delete(void* frame) noexcept
+            {
+                FramePool::deallocate(frame);
+            }
+
+            std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            FinalAwaiter final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void unhandled_exception() noexcept
+            {
+                exception_ = std::current_exception();
+            }
+
+            void set_continuation(std::coroutine_handle<> continuation) noexcept
+            {
+                continuation_ = continuation;
+            }
+
+            void rethrow_if_exception()
+            {
+                if (exception_)
+                    std::rethrow_exception(exception_);
+            }
+        };
+
+        template <typename T>
+        class Promise : public PromiseBase
+        {
+            std::optional<T> value_;
+
+        public:
+            task<T> get_return_object() noexcept;
+
+            template <typename U>
+            void return_value(U&& value)
+            {
+                value_.emplace(std::forward<U>(value));
+            }
+
+            T result()
+            {
+                rethrow_if_exception();
+                return std::move(*value_);
+            }
+        };
+
+        template <>
+        class Promise<void> : public PromiseBase
+        {
+        public:
+            task<void> get_return_object() noexcept;
+
+            void return_void() noexcept
+            {}
+
+            void result()
+            {
+                rethrow_if_exception();
+            }
+        };
+    }
+
+    // lazily started coroutine - runs when awaited
+    // - when it completes the awaiting coroutine is resumed in the same thread (worker of the pool)
+    template <typename T = void>
+    class [[nodiscard]] task
+    {
+    public:
+        using promise_type = details::Promise<T>;
+
+    private:
+        std::coroutine_handle<promise_type> coro_;
+
+    public:
+        explicit task(std::coroutine_handle<promise_type> coro) noexcept : coro_{coro}
+        {}
+
+        task(task&& other) noexcept : coro_{std::exchange(other.coro_, nullptr)}
+        {}
+
+        task& operator=(task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                if (coro_)
+                    coro_.destroy();
+                coro_ = std::exchange(other.coro_, nullptr);
+            }
+            return *this;
+        }
+
+        ~task()
+        {
+            if (coro_)
+                coro_.destroy();
+        }
+
+        auto operator co_await() && noexcept
+        {
+            struct Awaiter
+            {
+                std::coroutine_handle<promise_type> coro;
+
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    coro.promise().set_continuation(awaiting);
+                    return coro;
+                }
+
+                T await_resume()
+                {
+                    return coro.promise().result();
+                }
+            };
+
+            return Awaiter{coro_};
+        }
+    };
+
+    namespace details
+    {
+        template <typename T>
+        task<T> Promise<T>::get_return_object() noexcept
+        {
+            return task<T>{std::coroutine_handle<Promise<T>>::from_promise(*this)};
+        }
+
+        inline task<void> Promise<void>::get_return_object() noexcept
+        {
+            return task<void>{std::coroutine_handle<Promise<void>>::from_promise(*this)};
+        }
+
+        // coroutine started eagerly by sync_wait - signals the waiting thread when done
+        struct SyncWaitTask
+        {
+            struct promise_type
+            {
+                std::mutex mtx;
+                std::condition_variable cv;
+                bool is_done = false;
+
+                SyncWaitTask get_return_object() noexcept
+                {
+                    return SyncWaitTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+
+                std::suspend_never initial_suspend() noexcept
+                {
+                    return {};
+                }
+
+                auto final_suspend() noexcept
+                {
+                    struct Notifier
+                    {
+                        bool await_ready() const noexcept
+                        {
+                            return false;
+                        }
+
+                        void await_suspend(std::coroutine_handle<promise_type> h) noexcept
+                        {
+                            auto& promise = h.promise();
+                            std::lock_guard<std::mutex> lk{promise.mtx};
+                            promise.is_done = true;
+                            promise.cv.notify_one();
+                        }
+
+                        void await_resume() noexcept
+                        {}
+                    };
+
+                    return Notifier{};
+                }
+
+                void return_void() noexcept
+                {}
+
+                void unhandled_exception() noexcept
+                {
+                    std::terminate(); // exceptions are stored by the awaited task
+                }
+            };
+
+            std::coroutine_handle<promise_type> coro;
+
+            void wait()
+            {
+                auto& promise = coro.promise();
+                std::unique_lock<std::mutex> lk{promise.mtx};
+                promise.cv.wait(lk, [&promise] { return promise.is_done; });
+            }
+
+            ~SyncWaitTask()
+            {
+                coro.destroy();
+            }
+        };
+    }
+
+    namespace details
+    {
+        template <typename T>
+        SyncWaitTask make_sync_wait_task(task<T>& t, std::optional<T>& result, std::exception_ptr& exception)
+        {
+            try
+            {
+                result.emplace(co_await std::move(t));
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+        }
+
+        inline SyncWaitTask make_sync_wait_task(task<void>& t, std::exception_ptr& exception)
+        {
+            try
+            {
+                co_await std::move(t);
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+        }
+    }
+
+    // blocks the calling thread (e.g. main) until the task is completed
+    template <typename T>
+    T sync_wait(task<T> t)
+    {
+        std::exception_ptr exception;
+
+        if constexpr (std::is_void_v<T>)
+        {
+            details::make_sync_wait_task(t, exception).wait();
+
+            if (exception)
+                std::rethrow_exception(exception);
+        }
+        else
+        {
+            std::optional<T> result;
+            details::make_sync_wait_task(t, result, exception).wait();
+
+            if (exception)
+                std::rethrow_exception(exception);
+
+            return std::move(*result);
+        }
+    }
+}
+
+#endif // CORO_TASK_HPP
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "coro_task.hpp"
+
+using namespace std::literals;
+
+coro::task<int> calculate_square(ThreadPool& pool, int x)
+{
+    co_await pool.schedule();
+
+    std::cout << "Starting calculation for " << x << " in " << std::this_thread::get_id() << std::endl;
+
+    std::this_thread::sleep_for(100ms);
+
+    if (x % 3 == 0)
+        throw std::runtime_error("Error#3");
+
+    co_return x * x;
+}
+
+coro::task<> save_to_file(ThreadPool& pool, std::string filename, int value)
+{
+    co_await pool.schedule();
+
+    std::cout << "Saving to file: " << filename << " - " << value << " in " << std::this_thread::get_id() << std::endl;
+}
+
+coro::task<int> sum_of_squares(ThreadPool& pool, std::vector<int> items)
+{
+    int sum = 0;
+
+    for(int x : items)
+    {
+        try
+        {
+            sum += co_await calculate_square(pool, x);
+        }
+        catch(const std::runtime_error& e)
+        {
+            std::cout << "Caught: " << e.what() << std::endl;
+        }
+    }
+
+    co_await save_to_file(pool, "sum.txt", sum);
+
+    co_return sum;
+}
+
+int main()
+{
+    std::cout << "Main thread starts in " << std::this_thread::get_id() << std::endl;
+
+    ThreadPool thread_pool(4);
+
+    int result = coro::sync_wait(sum_of_squares(thread_pool, {1, 2, 3, 4, 5}));
+    std::cout << "Sum of squares: " << result << std::endl;
+
+    try
+    {
+        coro::sync_wait(calculate_square(thread_pool, 9));
+    }
+    catch(const std::runtime_error& e)
+    {
+        std::cout << "Caught: " << e.what() << std::endl;
+    }
+
+    std::cout << "Main thread ends..." << std::endl;
+}
@@ -0,0 +1,238 @@
+#ifndef CPU_TOPOLOGY_HPP
+#define CPU_TOPOLOGY_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct NumaNode
+{
+    int id;
+    std::vector<int> cpus;
+};
+
+// NUMA nodes & cpus as reported by /sys/devices/system/node
+// - on other systems (or when sysfs is not available) all cpus belong to a single node
+class CpuTopology
+{
+    std::vector<NumaNode> nodes_;
+    std::vector<size_t> node_index_of_cpu_;
+
+    // parses cpu (or node) list in format "0-3,8,10-11"
+    static std::vector<int> parse_cpu_list(const std::string& text)
+    {
+        std::vector<int> cpus;
+        std::stringstream ss{text};
+        std::string range;
+
+        while (std::getline(ss, range, ','))
+        {
+            if (range.empty() || range == "\n")
+                continue;
+
+            auto dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+            for(int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+
+        return cpus;
+    }
+
+public:
+    explicit CpuTopology(std::vector<NumaNode> nodes) : nodes_{std::move(nodes)}
+    {
+        for(size_t i = 0; i < nodes_.size(); ++i)
+        {
+            for(int cpu : nodes_[i].cpus)
+            {
+                if (static_cast<size_t>(cpu) >= node_index_of_cpu_.size())
+                    node_index_of_cpu_.resize(cpu + 1, 0);
+                node_index_of_cpu_[cpu] = i;
+            }
+        }
+    }
+
+    static CpuTopology detect()
+    {
+        std::vector<NumaNode> nodes;
+
+#ifdef __linux__
+        // node ids may have gaps (e.g. "0,2" with memory-only or offline nodes)
+        std::ifstream online{"/sys/devices/system/node/online"};
+        std::string online_nodes;
+        std::getline(online, online_nodes);
+
+        for(int id : parse_cpu_list(online_nodes))
+        {
+            std::ifstream cpu_list{"/sys/devices/system/node/node" + std::to_string(id) + "/cpulist"};
+            if (!cpu_list)
+                continue;
+
+            std::string text;
+            std::getline(cpu_list, text);
+
+            auto cpus = parse_cpu_list(text);
+            if (!cpus.empty())
+                nodes.push_back(NumaNode{id, std::move(cpus)});
+        }
+#endif
+
+        if (nodes.empty())
+        {
+            NumaNode node{0, {}};
+            for(unsigned int cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); ++cpu)
+                node.cpus.push_back(cpu);
+            nodes.push_back(std::move(node));
+        }
+
+        return CpuTopology{std::move(nodes)};
+    }
+
+    const std::vector<NumaNode>& nodes() const
+    {
+        return nodes_;
+    }
+
+    // index of node in nodes() for the cpu
+    size_t node_index_of(int cpu) const
+    {
+        if (cpu < 0 || static_cast<size_t>(cpu) >= node_index_of_cpu_.size())
+            return 0;
+        return node_index_of_cpu_[cpu];
+    }
+
+    // cpus ordered to fill one node before the next one
+    std::vector<int> compact_order() const
+    {
+        std::vector<int> cpus;
+        for(const auto& node : nodes_)
+            cpus.insert(cpus.end(), node.cpus.begin(), node.cpus.end());
+        return cpus;
+    }
+
+    // cpus ordered round-robin across nodes
+    std::vector<int> scatter_order() const
+    {
+        const size_t no_of_cpus = compact_order().size();
+
+        std::vector<int> cpus;
+        for(size_t i = 0; cpus.size() < no_of_cpus; ++i)
+        {
+            for(const auto& node : nodes_)
+                if (i < node.cpus.size())
+                    cpus.push_back(node.cpus[i]);
+        }
+        return cpus;
+    }
+};
+
+// cpu the calling thread is currently running on (-1 if unknown)
+inline int current_cpu()
+{
+#ifdef __linux__
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+inline bool pin_current_thread(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// cpu quota of the cgroup of the process rounded up (containers) - 0 if not limited
+// - the lowest quota of the cgroup & its ancestors applies
+inline size_t cgroup_cpu_limit()
+{
+#ifdef __linux__
+    // cgroup v2 - "<quota> <period>" or "max <period>" in cpu.max of each cgroup up to the root
+    std::string cgroup_path;
+    bool is_cgroup_v2 = false;
+    std::ifstream cgroups{"/proc/self/cgroup"};
+    for(std::string line; std::getline(cgroups, line);)
+        if (line.compare(0, 3, "0::") == 0)
+        {
+            cgroup_path = line.substr(3);
+            is_cgroup_v2 = true;
+        }
+
+    if (is_cgroup_v2)
+    {
+        size_t lowest_limit = 0;
+
+        for(std::string path = cgroup_path;; path.erase(path.rfind('/')))
+        {
+            std::ifstream cpu_max{"/sys/fs/cgroup" + path + "/cpu.max"};
+            std::string quota;
+            long period = 0;
+
+            if (cpu_max >> quota >> period && quota != "max" && period > 0)
+            {
+                long quota_us = std::stol(quota);
+                size_t limit = static_cast<size_t>((quota_us + period - 1) / period);
+
+                if (lowest_limit == 0 || limit < lowest_limit)
+                    lowest_limit = limit;
+            }
+
+            // the parent of "/a/b" is "/a", the root is ""
+            if (path.empty() || path == "/" || path.find('/') == std::string::npos)
+                break;
+        }
+
+        if (lowest_limit > 0)
+            return lowest_limit;
+    }
+
+    // cgroup v1 - quota is -1 if not limited
+    std::ifstream cfs_quota{"/sys/fs/cgroup/cpu/cpu.cfs_quota_us"};
+    std::ifstream cfs_period{"/sys/fs/cgroup/cpu/cpu.cfs_period_us"};
+    long quota = 0;
+    long period = 0;
+
+    if (cfs_quota >> quota && cfs_period >> period && quota > 0 && period > 0)
+        return static_cast<size_t>((quota + period - 1) / period);
+#endif
+    return 0;
+}
+
+// cpus the process may use - hardware threads limited by affinity mask & cgroup quota
+inline size_t available_cpus()
+{
+    size_t cpus = std::max(std::thread::hardware_concurrency(), 1u);
+
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+        cpus = std::min(cpus, static_cast<size_t>(std::max(CPU_COUNT(&cpu_set), 1)));
+#endif
+
+    size_t limit = cgroup_cpu_limit();
+    if (limit > 0)
+        cpus = std::min(cpus, limit);
+
+    return cpus;
+}
+
+#endif // CPU_TOPOLOGY_HPP
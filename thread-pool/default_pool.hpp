@@ -0,0 +1,123 @@
+#ifndef DEFAULT_POOL_HPP
+#define DEFAULT_POOL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "cpu_topology.hpp"
+#include "thread_pool.hpp"
+
+// Process-wide ThreadPool shared by libraries & short-lived tools
+// - started lazily on first use of default_pool() or async_pool()
+// - size: THREAD_POOL_SIZE environment variable, otherwise cpus available to the process (cgroup quota aware)
+// - destroyed at exit after draining its queue - tasks must not use objects with static storage destroyed before
+
+// number of workers of the default pool
+inline size_t default_pool_size()
+{
+    if (const char* env = std::getenv("THREAD_POOL_SIZE"))
+    {
+        char* end = nullptr;
+        unsigned long size = std::strtoul(env, &end, 10);
+
+        if (end != env && *end == '\0' && size > 0)
+            return static_cast<size_t>(size);
+    }
+
+    return available_cpus();
+}
+
+namespace details
+{
+    struct DefaultPoolConfig
+    {
+        std::mutex mtx;
+        bool is_created = false;
+        bool is_configured = false;
+        PoolOptions options;
+    };
+
+    // outlives the default pool - it is created before it
+    inline DefaultPoolConfig& default_pool_config()
+    {
+        static DefaultPoolConfig config;
+        return config;
+    }
+
+    inline PoolOptions default_pool_options()
+    {
+        auto& config = default_pool_config();
+        std::lock_guard<std::mutex> lk{config.mtx};
+
+        config.is_created = true;
+
+        if (!config.is_configured)
+            config.options.min_threads = config.options.max_threads = default_pool_size();
+
+        return config.options;
+    }
+}
+
+// options of the default pool - returns false (and has no effect) if the pool was already created
+inline bool configure_default_pool(const PoolOptions& options)
+{
+    auto& config = details::default_pool_config();
+    std::lock_guard<std::mutex> lk{config.mtx};
+
+    if (config.is_created)
+        return false;
+
+    config.options = options;
+    config.is_configured = true;
+    return true;
+}
+
+inline ThreadPool& default_pool()
+{
+    static ThreadPool pool{details::default_pool_options()};
+    return pool;
+}
+
+// creates the default pool ahead of its first use & waits until every worker has run a task
+// - thread start-up is paid at start of the program, not on the critical path
+// - each task waits at a barrier until all have started, so no worker can run two of them
+// - gives up after timeout - workers may be busy with tasks submitted before
+inline void prewarm_default_pool(std::chrono::milliseconds timeout = std::chrono::seconds{1})
+{
+    struct Barrier
+    {
+        std::mutex mtx;
+        std::condition_variable cv_all_arrived;
+        size_t arrived = 0;
+    };
+
+    ThreadPool& pool = default_pool();
+    const size_t no_of_workers = pool.size();
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    auto barrier = std::make_shared<Barrier>();
+
+    for(size_t i = 0; i < no_of_workers; ++i)
+        pool.execute([barrier, no_of_workers, deadline] {
+            std::unique_lock<std::mutex> lk{barrier->mtx};
+            if (++barrier->arrived == no_of_workers)
+                barrier->cv_all_arrived.notify_all();
+            else
+                barrier->cv_all_arrived.wait_until(lk, deadline, [&] { return barrier->arrived == no_of_workers; });
+        });
+
+    std::unique_lock<std::mutex> lk{barrier->mtx};
+    barrier->cv_all_arrived.wait_until(lk, deadline, [&] { return barrier->arrived == no_of_workers; });
+}
+
+// runs callable in the default pool
+template <typename Callable>
+auto async_pool(Callable&& callable)
+{
+    return default_pool().submit(std::forward<Callable>(callable));
+}
+
+#endif // DEFAULT_POOL_HPP
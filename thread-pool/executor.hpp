@@ -0,0 +1,73 @@
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "thread_pool.hpp"
+
+// Executor - anything that runs tasks (C++14: requirements are checked by is_executor):
+// - e.execute(Task)              fire & forget
+// - e.submit(callable)           returns TaskFuture<R> of callable()
+// - e.bulk_execute(n, f)         runs f(0), f(1), ..., f(n - 1) - returns BulkFuture
+// Models: ThreadPool, Strand (serial on a pool), InlineExecutor (calling thread)
+// Generic code takes an executor by reference, so CPU-bound, blocking & latency-critical
+// work can be isolated in separate pools without duplicating algorithms.
+
+namespace details
+{
+    template <typename...>
+    using void_t = void;
+
+    template <typename E, typename = void>
+    struct IsExecutor : std::false_type
+    {};
+
+    template <typename E>
+    struct IsExecutor<E, void_t<decltype(std::declval<E&>().execute(std::declval<Task>())),
+                                decltype(std::declval<E&>().submit(std::declval<void (*)()>())),
+                                decltype(std::declval<E&>().bulk_execute(size_t{}, std::declval<void (*)(size_t)>()))>>
+        : std::true_type
+    {};
+}
+
+template <typename E>
+struct is_executor : details::IsExecutor<E>
+{};
+
+// Runs tasks immediately in the calling thread
+// - reference executor for tests & for sequential execution of generic code
+// - exceptions of execute() propagate to the caller, submit() & bulk_execute() store them in the future
+class InlineExecutor
+{
+public:
+    void execute(Task task)
+    {
+        task();
+    }
+
+    template <typename Callable>
+    auto submit(Callable&& callable)
+    {
+        using ResultT = decltype(callable());
+
+        std::packaged_task<ResultT()> pt{std::forward<Callable>(callable)};
+        TaskFuture<ResultT> f{pt.get_future()};
+        pt();
+
+        return f;
+    }
+
+    template <typename Function>
+    BulkFuture bulk_execute(size_t n, Function f)
+    {
+        auto state = std::make_shared<details::BulkState>(n, std::move(f), [] {});
+        state->run_all();
+
+        return BulkFuture{std::move(state)};
+    }
+};
+
+#endif // EXECUTOR_HPP
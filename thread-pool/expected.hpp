@@ -0,0 +1,318 @@
+#ifndef EXPECTED_HPP
+#define EXPECTED_HPP
+
+#include <cassert>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Result channel of tasks for hot error paths - an error travels as a value, nothing is thrown
+// - a task returning Expected<T, E> is submitted as any other task: submit() gives TaskFuture<Expected<T, E>>
+// - simplified std::expected of C++23 (assignment is not exception-safe if constructors of T or E throw)
+
+template <typename E>
+class Unexpected
+{
+    E error_;
+
+public:
+    explicit Unexpected(E error) : error_{std::move(error)}
+    {}
+
+    E& error() & noexcept
+    {
+        return error_;
+    }
+
+    E&& error() && noexcept
+    {
+        return std::move(error_);
+    }
+};
+
+template <typename E>
+Unexpected<std::decay_t<E>> make_unexpected(E&& error)
+{
+    return Unexpected<std::decay_t<E>>{std::forward<E>(error)};
+}
+
+// thrown by value() of an Expected holding an error
+template <typename E>
+class BadExpectedAccess : public std::logic_error
+{
+    E error_;
+
+public:
+    explicit BadExpectedAccess(E error) : std::logic_error{"bad expected access"}, error_{std::move(error)}
+    {}
+
+    const E& error() const noexcept
+    {
+        return error_;
+    }
+};
+
+template <typename T, typename E>
+class Expected
+{
+    union
+    {
+        T value_;
+        E error_;
+    };
+    bool has_value_;
+
+    template <typename Other>
+    void construct_from(Other&& other)
+    {
+        if (other.has_value_)
+            new (&value_) T(std::forward<Other>(other).value_);
+        else
+            new (&error_) E(std::forward<Other>(other).error_);
+        has_value_ = other.has_value_;
+    }
+
+    void destroy() noexcept
+    {
+        if (has_value_)
+            value_.~T();
+        else
+            error_.~E();
+    }
+
+public:
+    template <typename U = T, typename = std::enable_if_t<std::is_default_constructible<U>::value>>
+    Expected() : value_{}, has_value_{true}
+    {}
+
+    Expected(const T& value) : value_{value}, has_value_{true}
+    {}
+
+    Expected(T&& value) : value_{std::move(value)}, has_value_{true}
+    {}
+
+    template <typename G>
+    Expected(Unexpected<G> unexpected) : error_{std::move(unexpected).error()}, has_value_{false}
+    {}
+
+    Expected(const Expected& other)
+    {
+        construct_from(other);
+    }
+
+    Expected(Expected&& other) noexcept(std::is_nothrow_move_constructible<T>::value && std::is_nothrow_move_constructible<E>::value)
+    {
+        construct_from(std::move(other));
+    }
+
+    Expected& operator=(const Expected& other)
+    {
+        if (this != &other)
+        {
+            destroy();
+            construct_from(other);
+        }
+        return *this;
+    }
+
+    Expected& operator=(Expected&& other) noexcept(std::is_nothrow_move_constructible<T>::value && std::is_nothrow_move_constructible<E>::value)
+    {
+        if (this != &other)
+        {
+            destroy();
+            construct_from(std::move(other));
+        }
+        return *this;
+    }
+
+    ~Expected()
+    {
+        destroy();
+    }
+
+    bool has_value() const noexcept
+    {
+        return has_value_;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return has_value_;
+    }
+
+    // throws BadExpectedAccess<E> if an error is held
+    T& value() &
+    {
+        if (!has_value_)
+            throw BadExpectedAccess<E>{error_};
+        return value_;
+    }
+
+    const T& value() const &
+    {
+        if (!has_value_)
+            throw BadExpectedAccess<E>{error_};
+        return value_;
+    }
+
+    T&& value() &&
+    {
+        if (!has_value_)
+            throw BadExpectedAccess<E>{error_};
+        return std::move(value_);
+    }
+
+    template <typename U>
+    T value_or(U&& default_value) const &
+    {
+        return has_value_ ? value_ : static_cast<T>(std::forward<U>(default_value));
+    }
+
+    T& operator*() & noexcept
+    {
+        assert(has_value_);
+        return value_;
+    }
+
+    const T& operator*() const & noexcept
+    {
+        assert(has_value_);
+        return value_;
+    }
+
+    T* operator->() noexcept
+    {
+        assert(has_value_);
+        return &value_;
+    }
+
+    const T* operator->() const noexcept
+    {
+        assert(has_value_);
+        return &value_;
+    }
+
+    E& error() & noexcept
+    {
+        assert(!has_value_);
+        return error_;
+    }
+
+    const E& error() const & noexcept
+    {
+        assert(!has_value_);
+        return error_;
+    }
+
+    E&& error() && noexcept
+    {
+        assert(!has_value_);
+        return std::move(error_);
+    }
+};
+
+// success without a value or an error - E needs no default constructor, it exists only when an error is held
+template <typename E>
+class Expected<void, E>
+{
+    union
+    {
+        E error_;
+    };
+    bool has_value_;
+
+    template <typename Other>
+    void construct_from(Other&& other)
+    {
+        if (!other.has_value_)
+            new (&error_) E(std::forward<Other>(other).error_);
+        has_value_ = other.has_value_;
+    }
+
+    void destroy() noexcept
+    {
+        if (!has_value_)
+            error_.~E();
+    }
+
+public:
+    Expected() noexcept : has_value_{true}
+    {}
+
+    template <typename G>
+    Expected(Unexpected<G> unexpected) : error_{std::move(unexpected).error()}, has_value_{false}
+    {}
+
+    Expected(const Expected& other)
+    {
+        construct_from(other);
+    }
+
+    Expected(Expected&& other) noexcept(std::is_nothrow_move_constructible<E>::value)
+    {
+        construct_from(std::move(other));
+    }
+
+    Expected& operator=(const Expected& other)
+    {
+        if (this != &other)
+        {
+            destroy();
+            construct_from(other);
+        }
+        return *this;
+    }
+
+    Expected& operator=(Expected&& other) noexcept(std::is_nothrow_move_constructible<E>::value)
+    {
+        if (this != &other)
+        {
+            destroy();
+            construct_from(std::move(other));
+        }
+        return *this;
+    }
+
+    ~Expected()
+    {
+        destroy();
+    }
+
+    bool has_value() const noexcept
+    {
+        return has_value_;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return has_value_;
+    }
+
+    // throws BadExpectedAccess<E> if an error is held
+    void value() const
+    {
+        if (!has_value_)
+            throw BadExpectedAccess<E>{error_};
+    }
+
+    E& error() & noexcept
+    {
+        assert(!has_value_);
+        return error_;
+    }
+
+    const E& error() const & noexcept
+    {
+        assert(!has_value_);
+        return error_;
+    }
+
+    E&& error() && noexcept
+    {
+        assert(!has_value_);
+        return std::move(error_);
+    }
+};
+
+#endif // EXPECTED_HPP
@@ -0,0 +1,319 @@
+#ifndef FIBER_HPP
+#define FIBER_HPP
+
+// fibers are opt-in - define THREAD_POOL_FIBERS (CMake option THREAD_POOL_FIBERS) to enable them
+#if defined(THREAD_POOL_FIBERS)
+
+// fibers are built on ucontext - POSIX only
+#if !defined(__unix__) || defined(__APPLE__)
+#error "THREAD_POOL_FIBERS requires ucontext (Linux, BSD)"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+// ThreadSanitizer must be told about switches of stacks
+#if defined(__SANITIZE_THREAD__)
+#define THREAD_POOL_TSAN_FIBERS 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define THREAD_POOL_TSAN_FIBERS 1
+#endif
+#endif
+
+#if defined(THREAD_POOL_TSAN_FIBERS)
+extern "C" {
+void* __tsan_get_current_fiber();
+void* __tsan_create_fiber(unsigned flags);
+void __tsan_destroy_fiber(void* fiber);
+void __tsan_switch_to_fiber(void* fiber, unsigned flags);
+}
+#endif
+
+namespace details
+{
+    // Thread-local pointers that belong to the running task rather than to the thread (e.g. the current strand)
+    // - values are saved when a fiber is suspended and restored when it is resumed
+    // - a task started on a fiber sees null values
+    class FiberLocals
+    {
+    public:
+        static constexpr size_t capacity = 8;
+        using Values = std::array<void*, capacity>;
+
+    private:
+        struct Entry
+        {
+            void* (*get)();
+            void (*set)(void*);
+        };
+
+        static std::array<Entry, capacity>& entries()
+        {
+            static std::array<Entry, capacity> entries;
+            return entries;
+        }
+
+        static std::atomic<size_t>& size()
+        {
+            static std::atomic<size_t> size{0};
+            return size;
+        }
+
+    public:
+        // registers thread-local T* returned by Accessor() - returns true, so it may initialize a static
+        template <typename T, T*& (*Accessor)()>
+        static bool add()
+        {
+            static std::mutex mtx;
+            std::lock_guard<std::mutex> lk{mtx};
+
+            const size_t index = size().load(std::memory_order_relaxed);
+            assert(index < capacity);
+
+            entries()[index] = Entry{
+                [] { return const_cast<void*>(static_cast<const void*>(Accessor())); },
+                [](void* value) { Accessor() = static_cast<T*>(value); }};
+            size().store(index + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        static void save(Values& values)
+        {
+            const size_t n = size().load(std::memory_order_acquire);
+            for(size_t i = 0; i < n; ++i)
+                values[i] = entries()[i].get();
+        }
+
+        static void restore(const Values& values)
+        {
+            const size_t n = size().load(std::memory_order_acquire);
+            for(size_t i = 0; i < n; ++i)
+                entries()[i].set(values[i]);
+        }
+    };
+
+    // Fibers of one worker - user-mode threads with own small stacks
+    // - a task runs on a fiber; when it waits, the fiber is suspended and the worker takes other tasks
+    // - suspended fibers are polled by the worker and resumed when their wait is over
+    // - fibers never migrate between threads (thread_locals stay valid)
+    // - finished fibers are kept with their stacks for next tasks
+    // - stacks are mapped with a guard page below them - an overflow faults instead of corrupting the heap
+    class FiberScheduler
+    {
+        static constexpr size_t max_free_fibers = 64;
+        static constexpr size_t poll_period = 32; // tasks started between polls of suspended fibers
+
+        struct Fiber
+        {
+            ucontext_t context;
+            void* stack = MAP_FAILED;       // guard page & stack
+            size_t stack_size = 0;          // including the guard page
+            std::function<void()> entry;    // empty when finished
+            std::function<bool()> is_ready; // wait condition of suspended fiber
+            FiberLocals::Values locals{};   // saved while the fiber is suspended
+#if defined(THREAD_POOL_TSAN_FIBERS)
+            void* tsan_fiber = __tsan_create_fiber(0);
+#endif
+
+            Fiber() = default;
+            Fiber(const Fiber&) = delete;
+            Fiber& operator=(const Fiber&) = delete;
+
+            ~Fiber()
+            {
+                if (stack != MAP_FAILED)
+                    ::munmap(stack, stack_size);
+#if defined(THREAD_POOL_TSAN_FIBERS)
+                __tsan_destroy_fiber(tsan_fiber);
+#endif
+            }
+        };
+
+        const size_t stack_size_; // rounded up to pages
+        const size_t page_size_;
+        ucontext_t scheduler_context_;
+        FiberLocals::Values scheduler_locals_{}; // saved while a fiber runs
+        Fiber* running_ = nullptr;
+#if defined(THREAD_POOL_TSAN_FIBERS)
+        void* tsan_scheduler_fiber_ = __tsan_get_current_fiber();
+#endif
+        std::vector<std::unique_ptr<Fiber>> free_fibers_;
+        std::vector<std::unique_ptr<Fiber>> suspended_fibers_;
+        size_t polls_skipped_ = 0;
+
+        static FiberScheduler*& current()
+        {
+            static thread_local FiberScheduler* scheduler = nullptr;
+            return scheduler;
+        }
+
+        // a fiber runs entries of many tasks - it is created once
+        static void fiber_main()
+        {
+            while (true)
+            {
+                FiberScheduler& scheduler = *current();
+                Fiber& fiber = *scheduler.running_;
+
+                fiber.entry();
+                fiber.entry = nullptr;
+
+                scheduler.switch_to_scheduler(fiber);
+            }
+        }
+
+        static size_t round_up_to_pages(size_t size)
+        {
+            const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+            return (std::max<size_t>(size, 1) + page_size - 1) / page_size * page_size;
+        }
+
+        std::unique_ptr<Fiber> take_fiber()
+        {
+            if (!free_fibers_.empty())
+            {
+                auto fiber = std::move(free_fibers_.back());
+                free_fibers_.pop_back();
+                return fiber;
+            }
+
+            auto fiber = std::make_unique<Fiber>();
+            fiber->stack_size = page_size_ + stack_size_;
+            fiber->stack = ::mmap(nullptr, fiber->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+
+            if (fiber->stack == MAP_FAILED)
+                throw std::bad_alloc{};
+
+            // stack grows down - the lowest page is the guard
+            if (::mprotect(fiber->stack, page_size_, PROT_NONE) != 0)
+                throw std::bad_alloc{};
+
+            if (getcontext(&fiber->context) != 0)
+                std::abort();
+            fiber->context.uc_stack.ss_sp = static_cast<char*>(fiber->stack) + page_size_;
+            fiber->context.uc_stack.ss_size = stack_size_;
+            fiber->context.uc_link = nullptr;
+            makecontext(&fiber->context, &FiberScheduler::fiber_main, 0);
+
+            return fiber;
+        }
+
+        void switch_to_scheduler(Fiber& fiber)
+        {
+            FiberLocals::save(fiber.locals);
+            FiberLocals::restore(scheduler_locals_);
+#if defined(THREAD_POOL_TSAN_FIBERS)
+            __tsan_switch_to_fiber(tsan_scheduler_fiber_, 0);
+#endif
+            swapcontext(&fiber.context, &scheduler_context_);
+        }
+
+        // returns when the fiber finishes or suspends
+        void switch_to(std::unique_ptr<Fiber> fiber)
+        {
+            current() = this;
+            running_ = fiber.get();
+            FiberLocals::save(scheduler_locals_);
+            FiberLocals::restore(fiber->locals);
+#if defined(THREAD_POOL_TSAN_FIBERS)
+            __tsan_switch_to_fiber(fiber->tsan_fiber, 0);
+#endif
+            swapcontext(&scheduler_context_, &fiber->context);
+            running_ = nullptr;
+
+            if (fiber->entry)
+                suspended_fibers_.push_back(std::move(fiber));
+            else if (free_fibers_.size() < max_free_fibers)
+                free_fibers_.push_back(std::move(fiber));
+        }
+
+    public:
+        explicit FiberScheduler(size_t stack_size)
+            : stack_size_{round_up_to_pages(stack_size)}, page_size_{static_cast<size_t>(::sysconf(_SC_PAGESIZE))}
+        {}
+
+        FiberScheduler(const FiberScheduler&) = delete;
+        FiberScheduler& operator=(const FiberScheduler&) = delete;
+
+        ~FiberScheduler()
+        {
+            assert(suspended_fibers_.empty());
+        }
+
+        // true if called from a fiber of this scheduler
+        bool in_fiber() const
+        {
+            return running_ != nullptr;
+        }
+
+        bool has_suspended() const
+        {
+            return !suspended_fibers_.empty();
+        }
+
+        // runs entry on a fiber - returns when the entry finishes or waits
+        void run(std::function<void()> entry)
+        {
+            assert(!in_fiber());
+
+            auto fiber = take_fiber();
+            fiber->entry = std::move(entry);
+            fiber->locals = FiberLocals::Values{};
+            switch_to(std::move(fiber));
+        }
+
+        // called from a fiber - the worker continues with other tasks until is_ready() returns true
+        void suspend(std::function<bool()> is_ready)
+        {
+            assert(in_fiber());
+
+            Fiber& fiber = *running_;
+            fiber.is_ready = std::move(is_ready);
+            switch_to_scheduler(fiber);
+        }
+
+        // resumes suspended fibers that may continue - returns true if any was resumed
+        // - without force the fibers are polled only once per poll_period calls
+        bool resume_ready(bool force = false)
+        {
+            if (suspended_fibers_.empty() || (!force && ++polls_skipped_ < poll_period))
+                return false;
+
+            polls_skipped_ = 0;
+
+            auto first_ready = std::partition(suspended_fibers_.begin(), suspended_fibers_.end(),
+                                              [](const std::unique_ptr<Fiber>& fiber) { return !fiber->is_ready(); });
+
+            std::vector<std::unique_ptr<Fiber>> ready{std::make_move_iterator(first_ready), std::make_move_iterator(suspended_fibers_.end())};
+            suspended_fibers_.erase(first_ready, suspended_fibers_.end());
+
+            for(auto& fiber : ready)
+            {
+                fiber->is_ready = nullptr;
+                switch_to(std::move(fiber));
+            }
+
+            return !ready.empty();
+        }
+    };
+}
+
+#endif
+
+#endif // FIBER_HPP
@@ -8,12 +8,29 @@
 #include <atomic>
 #include <random>
 #include <future>
+#include <numeric>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include "thread_pool.hpp"
+#include "task_group.hpp"
+#include "task_graph.hpp"
+#include "strand.hpp"
+#include "parallel_pipeline.hpp"
+#include "parallel_for.hpp"
+#include "executor.hpp"
+#include "async_file_io.hpp"
+#include "task_mutex.hpp"
+#include "expected.hpp"
+#include "default_pool.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#endif
 #include "thread_safe_queue.hpp"
 
 using namespace std::literals;
 
-using Task = std::function<void()>;
-
 const Task end_of_work;
 
 namespace ver_1_0
@@ -70,59 +87,6 @@ namespace ver_1_0
     };
 }
 
-class ThreadPool
-{
-    std::vector<std::thread> threads_;
-    ThreadSafeQueue<Task> tasks_;
-    std::atomic<bool> is_done_{false};
-
-    void run()
-    {
-        while(true)
-        {
-            Task task;
-            tasks_.pop(task);
-
-            task(); // execution of task
-
-            if (is_done_)
-                return;
-        }
-    }
-
-public:
-    ThreadPool(size_t size) : threads_(size)
-    {
-        for(size_t i = 0; i < size; ++i)
-            threads_[i] = std::thread{[this] { run(); }};
-    }
-
-    ThreadPool(const ThreadPool&) = delete;
-    ThreadPool& operator=(const ThreadPool&) = delete;
-
-    template <typename Callable>
-    auto submit(Callable&& callable)
-    {
-        using ResultT = decltype(callable());
-
-        auto pt = std::make_shared<std::packaged_task<ResultT()>>(std::forward<Callable>(callable));
-        std::future<ResultT> f = pt->get_future();
-        tasks_.push([pt] { (*pt)(); });
-
-        return f;
-    }
-
-    ~ThreadPool()
-    {
-        // weakup
-        for(size_t i = 0; i < threads_.size(); ++i)
-            submit([this] { is_done_ = true; });
-
-        for(auto& thd : threads_)
-            thd.join();
-    }
-};
-
 void background_work(size_t id, const std::string& text, std::chrono::milliseconds delay)
 {
     std::cout << "bw#" << id << " has started..." << std::endl;
@@ -162,20 +126,17 @@ void save_to_file(const std::string& filename)
 }
 
 
-int main()
+void thread_pool_demo()
 {
-    std::cout << "Main thread starts..." << std::endl;
-    const std::string text = "Hello Threads";
-
     ThreadPool thread_pool(8);
 
-    //thread_pool.submit([&] { background_work(1, text, 100ms); });
+    //thread_pool.submit([&] { background_work(1, "Hello Threads", 100ms); });
 
-    std::vector<std::future<int>> squares;
+    std::vector<TaskFuture<int>> squares;
 
     for(int i = 1; i <= 20; ++i)
     {
-        std::future<int> f_sqr = thread_pool.submit([i] { return calculate_square(i); });
+        TaskFuture<int> f_sqr = thread_pool.submit([i] { return calculate_square(i); });
         squares.push_back(std::move(f_sqr));
     }
 
@@ -191,13 +152,10 @@ int main()
             std::cout << "Caught: " << e.what() << std::endl;
         }
     }
+}
 
-    std::cout << "Main thread ends..." << std::endl;
-
-
-    ///////////////////////
-    /// ref vs. shared_ptr
-
+void ref_vs_shared_ptr_demo()
+{
     auto sum = [](std::shared_ptr<const std::vector<int>> data)
     {
         long result =  std::accumulate(data->begin(), data->end(), 0);
@@ -220,3 +178,1066 @@ int main()
 
     std::this_thread::sleep_for(15s);
 }
+
+///////////////////////
+/// fork-join
+
+long fib(int n)
+{
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+long parallel_fib(ThreadPool& pool, int n)
+{
+    if (n < 20)
+        return fib(n);
+
+    long x, y;
+
+    TaskGroup tg{pool};
+    tg.run([&] { x = parallel_fib(pool, n - 1); });
+    tg.run([&] { y = parallel_fib(pool, n - 2); });
+    tg.wait();
+
+    return x + y;
+}
+
+template <typename Iterator>
+void parallel_quicksort(ThreadPool& pool, Iterator first, Iterator last)
+{
+    if (std::distance(first, last) < 10'000)
+    {
+        std::sort(first, last);
+        return;
+    }
+
+    auto pivot = *std::next(first, std::distance(first, last) / 2);
+    auto middle1 = std::partition(first, last, [&](const auto& item) { return item < pivot; });
+    auto middle2 = std::partition(middle1, last, [&](const auto& item) { return !(pivot < item); });
+
+    TaskGroup tg{pool};
+    tg.run([&] { parallel_quicksort(pool, first, middle1); });
+    tg.run([&] { parallel_quicksort(pool, middle2, last); });
+    tg.wait();
+}
+
+void task_group_demo()
+{
+    ThreadPool thread_pool(8);
+
+    std::cout << "fib(32) = " << parallel_fib(thread_pool, 32) << std::endl;
+
+    std::vector<int> data(1'000'000);
+    std::mt19937_64 rnd_gen{42};
+    std::generate(data.begin(), data.end(), [&] { return static_cast<int>(rnd_gen() % 100'000); });
+
+    parallel_quicksort(thread_pool, data.begin(), data.end());
+    std::cout << "is sorted: " << std::boolalpha << std::is_sorted(data.begin(), data.end()) << std::endl;
+
+    TaskGroup tg{thread_pool};
+    for(int i = 1; i <= 6; ++i)
+        tg.run([i] { calculate_square(i); });
+
+    try
+    {
+        tg.wait();
+    }
+    catch(const std::runtime_error& e)
+    {
+        std::cout << "Caught: " << e.what() << std::endl;
+    }
+}
+
+///////////////////////
+/// nested submissions
+
+void nested_futures_demo()
+{
+    ThreadPool thread_pool(2);
+
+    std::vector<TaskFuture<int>> results;
+
+    for(int i = 1; i <= 8; ++i)
+    {
+        results.push_back(thread_pool.submit([&thread_pool, i] {
+            auto f1 = thread_pool.submit([i] { return i * i; });
+            auto f2 = thread_pool.submit([i] { return i * i * i; });
+
+            return f1.get() + f2.get(); // worker runs other tasks while waiting
+        }));
+    }
+
+    for(auto& r : results)
+        std::cout << r.get() << " ";
+    std::cout << std::endl;
+
+    auto stats = thread_pool.stats();
+    std::cout << "helped tasks: " << stats.helped_tasks
+              << "; helping time: " << std::chrono::duration_cast<std::chrono::microseconds>(stats.helping_time).count() << "us" << std::endl;
+}
+
+///////////////////////
+/// elastic pool
+
+void elastic_pool_demo()
+{
+    PoolOptions options;
+    options.min_threads = 2;
+    options.max_threads = 8;
+    options.keep_alive = 500ms;
+
+    ThreadPool thread_pool(options);
+
+    std::vector<TaskFuture<void>> results;
+    for(int i = 1; i <= 16; ++i)
+        results.push_back(thread_pool.submit([] { std::this_thread::sleep_for(200ms); }));
+
+    for(auto& r : results)
+        r.wait();
+
+    auto print_stats = [&thread_pool] {
+        auto stats = thread_pool.stats();
+        std::cout << "threads: " << stats.threads
+                  << "; spawned: " << stats.threads_spawned
+                  << "; retired: " << stats.threads_retired << std::endl;
+    };
+
+    print_stats();
+    std::this_thread::sleep_for(1s);
+    print_stats();
+}
+
+///////////////////////
+/// NUMA placement
+
+// data of a chain is allocated (first touched) by its first task - memory is placed on the NUMA node of that task
+struct ChainData
+{
+    std::vector<long> values;
+    size_t home_node;
+};
+
+// hops of chains - a hop on other node than the home node of its data reads remote memory
+struct ChainCounters
+{
+    std::atomic<size_t> hops{0};
+    std::atomic<size_t> cross_node_hops{0};
+};
+
+void chain_of_tasks(const CpuTopology& topology, std::shared_ptr<ChainData> data, int hops, TaskGroup& tg, ChainCounters& counters)
+{
+    ++counters.hops;
+    if (topology.node_index_of(current_cpu()) != data->home_node)
+        ++counters.cross_node_hops;
+
+    std::for_each(data->values.begin(), data->values.end(), [](long& x) { x = x * 31 + 7; });
+
+    if (hops > 0)
+        tg.run([&topology, data, hops, &tg, &counters] { chain_of_tasks(topology, data, hops - 1, tg, counters); });
+}
+
+// 64 chains of 100 tasks passing 128kB of data on - returns time in ms
+long long run_chains(ThreadPool& thread_pool, const CpuTopology& topology, ChainCounters& counters)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        TaskGroup tg{thread_pool};
+        for(int i = 0; i < 64; ++i)
+        {
+            tg.run([&topology, i, &tg, &counters] {
+                auto data = std::make_shared<ChainData>(ChainData{std::vector<long>(16 * 1024, i), topology.node_index_of(current_cpu())});
+                chain_of_tasks(topology, data, 100, tg, counters);
+            });
+        }
+        tg.wait();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+// unpinned workers migrate between nodes with their tasks - pinned ones keep the tasks of a node on it
+void numa_placement_benchmark()
+{
+    const auto topology = CpuTopology::detect();
+    std::cout << "NUMA nodes: " << topology.nodes().size() << std::endl;
+    std::cout << "placement,time_ms,hops,cross_node_hops,local_pops,remote_pops" << std::endl;
+
+    const std::pair<Placement, const char*> placements[] = {
+        {Placement::none, "none"}, {Placement::compact, "compact"}, {Placement::scatter, "scatter"}};
+
+    for(const auto& placement : placements)
+    {
+        PoolOptions options;
+        options.placement = placement.first;
+
+        ThreadPool thread_pool(options);
+        ChainCounters counters;
+
+        auto time_ms = run_chains(thread_pool, topology, counters);
+
+        auto stats = thread_pool.stats();
+        std::cout << placement.second << "," << time_ms << "," << counters.hops << "," << counters.cross_node_hops << ","
+                  << stats.local_pops << "," << stats.remote_pops << std::endl;
+    }
+}
+
+///////////////////////
+/// cancellation
+
+int calculate_square_with_timeout(int x, ext::stop_token token)
+{
+    for(int i = 0; i < 50; ++i)
+    {
+        if (token.stop_requested())
+            throw TaskCancelled{};
+
+        std::this_thread::sleep_for(20ms);
+    }
+
+    return x * x;
+}
+
+void cancellation_demo()
+{
+    ThreadPool thread_pool(2);
+    ext::stop_source stop_src;
+
+    std::vector<TaskFuture<int>> squares;
+
+    for(int i = 1; i <= 8; ++i)
+        squares.push_back(thread_pool.submit(stop_src.get_token(), [i](ext::stop_token token) {
+            return calculate_square_with_timeout(i, token); }));
+
+    std::this_thread::sleep_for(1500ms);
+    stop_src.request_stop();
+
+    for(auto& s : squares)
+    {
+        try
+        {
+            std::cout << s.get() << std::endl;
+        }
+        catch(const TaskCancelled& e)
+        {
+            std::cout << "Caught: " << e.what() << std::endl;
+        }
+    }
+
+    std::cout << "dropped tasks: " << thread_pool.stats().cancelled_tasks << std::endl;
+}
+
+///////////////////////
+/// delayed & periodic tasks
+
+void delayed_tasks_demo()
+{
+    ThreadPool thread_pool(2);
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [start] {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    auto saved = thread_pool.submit_after(1s, [&] { std::cout << "File saved after " << elapsed_ms() << "ms" << std::endl; });
+    auto square = thread_pool.submit_at(std::chrono::steady_clock::now() + 500ms, [] { return 13 * 13; });
+
+    TimerHandle heartbeat = thread_pool.submit_every(200ms, [&] { std::cout << "heartbeat at " << elapsed_ms() << "ms" << std::endl; });
+
+    auto reminder = thread_pool.submit_after(10s, [] { std::cout << "Reminder" << std::endl; });
+    std::cout << "reminder cancelled: " << reminder.cancel() << std::endl;
+
+    try
+    {
+        reminder.get();
+    }
+    catch (const TaskCancelled& e)
+    {
+        std::cout << "Caught: " << e.what() << std::endl;
+    }
+
+    std::cout << "square: " << square.get() << " after " << elapsed_ms() << "ms" << std::endl;
+    saved.wait();
+
+    heartbeat.cancel();
+}
+
+///////////////////////
+/// task graph
+
+void task_graph_demo()
+{
+    ThreadPool thread_pool(4);
+
+    std::vector<int> a, b;
+    int result = 0;
+
+    TaskGraph graph;
+    auto load_a = graph.emplace([&] { a = {1, 2, 3}; }, "load A");
+    auto load_b = graph.emplace([&] { b = {4, 5, 6}; }, "load B");
+    auto combine = graph.emplace([&] { result = std::inner_product(a.begin(), a.end(), b.begin(), 0); }, "combine");
+    auto save = graph.emplace([&] { std::cout << "Saving result: " << result << std::endl; }, "save");
+
+    combine.succeed(load_a).succeed(load_b).precede(save);
+
+    graph.dump(std::cout);
+
+    for(int run = 0; run < 3; ++run)
+        graph.run_and_wait(thread_pool);
+}
+
+///////////////////////
+/// priorities & deadlines
+
+void priorities_demo()
+{
+    ThreadPool thread_pool(1);
+
+    std::promise<void> gate;
+    auto blocker = thread_pool.submit([f = gate.get_future().share()] { f.wait(); });
+
+    std::vector<TaskFuture<void>> results;
+    auto log = [](const std::string& name) { return [name] { std::cout << "run: " << name << std::endl; }; };
+
+    for(int i = 1; i <= 3; ++i)
+        results.push_back(thread_pool.submit(Priority::low, log("bulk#" + std::to_string(i))));
+    results.push_back(thread_pool.submit(log("normal")));
+    results.push_back(thread_pool.submit(Priority::high, log("latency critical")));
+    results.push_back(thread_pool.submit(Deadline{std::chrono::steady_clock::now() + 50ms}, log("deadline in 50ms")));
+    results.push_back(thread_pool.submit(Deadline{std::chrono::steady_clock::now() + 10ms}, log("deadline in 10ms")));
+
+    gate.set_value();
+
+    for(auto& r : results)
+        r.wait();
+}
+
+///////////////////////
+/// strands
+
+class BankAccount
+{
+    const int id_;
+    double balance_;
+    Strand strand_; // serializes access to balance_ - no mutex
+
+public:
+    BankAccount(int id, double balance, ThreadPool& pool)
+        : id_{id}, balance_{balance}, strand_{pool}
+    {}
+
+    void deposit(double amount)
+    {
+        strand_.execute([this, amount] { balance_ += amount; });
+    }
+
+    void withdraw(double amount)
+    {
+        strand_.execute([this, amount] { balance_ -= amount; });
+    }
+
+    void transfer(BankAccount& to, double amount)
+    {
+        strand_.execute([this, &to, amount] {
+            balance_ -= amount;
+            to.deposit(amount);
+        });
+    }
+
+    TaskFuture<double> balance()
+    {
+        return strand_.submit([this] { return balance_; });
+    }
+
+    int id() const
+    {
+        return id_;
+    }
+};
+
+void strand_demo()
+{
+    ThreadPool thread_pool(4);
+
+    BankAccount ba1{1, 10'000, thread_pool};
+    BankAccount ba2{2, 10'000, thread_pool};
+
+    std::thread thd1{[&] {
+        for(int i = 0; i < 10'000; ++i)
+            ba1.transfer(ba2, 1.0);
+    }};
+
+    std::thread thd2{[&] {
+        for(int i = 0; i < 10'000; ++i)
+            ba2.transfer(ba1, 1.0);
+    }};
+
+    thd1.join();
+    thd2.join();
+
+    // transfers post deposits to the other strand - flushing both strands in turn completes all of them
+    ba1.balance().wait();
+    ba2.balance().wait();
+
+    std::cout << "Bank Account #" << ba1.id() << "; Balance = " << ba1.balance().get() << std::endl;
+    std::cout << "Bank Account #" << ba2.id() << "; Balance = " << ba2.balance().get() << std::endl;
+}
+
+///////////////////////
+/// metrics
+
+void metrics_demo()
+{
+    ThreadPool thread_pool(4);
+
+    auto stats_dump = thread_pool.dump_stats_every(100ms, "pool_stats.jsonl");
+
+    std::vector<TaskFuture<int>> results;
+    for(int i = 1; i <= 200; ++i)
+    {
+        results.push_back(thread_pool.submit([i] {
+            std::this_thread::sleep_for(std::chrono::microseconds(100 * (i % 10)));
+            if (i % 50 == 0)
+                throw std::runtime_error("Error#50");
+            return i;
+        }));
+    }
+
+    for(auto& r : results)
+        r.wait();
+
+    stats_dump.cancel();
+
+    auto stats = thread_pool.stats();
+    std::cout << "completed: " << stats.tasks_completed << "; failed: " << stats.tasks_failed << std::endl;
+    std::cout << "queue wait p50/p99: " << std::chrono::duration_cast<std::chrono::microseconds>(stats.queue_wait_time.percentile(50)).count()
+              << "us/" << std::chrono::duration_cast<std::chrono::microseconds>(stats.queue_wait_time.percentile(99)).count() << "us" << std::endl;
+    std::cout << "execution p50/p99: " << std::chrono::duration_cast<std::chrono::microseconds>(stats.execution_time.percentile(50)).count()
+              << "us/" << std::chrono::duration_cast<std::chrono::microseconds>(stats.execution_time.percentile(99)).count() << "us" << std::endl;
+    stats.write(std::cout);
+}
+
+///////////////////////
+/// tracing
+
+void trace_demo()
+{
+    PoolOptions options;
+    options.min_threads = 4;
+    options.max_threads = 4;
+    options.trace_buffer_size = 16 * 1024;
+
+    ThreadPool thread_pool(options);
+
+    std::vector<int> data(1'000'000);
+    std::mt19937_64 rnd_gen{665};
+    std::generate(data.begin(), data.end(), [&] { return static_cast<int>(rnd_gen() % 100'000); });
+
+    parallel_quicksort(thread_pool, data.begin(), data.end());
+
+    std::ofstream trace_file{"pool_trace.json"};
+    thread_pool.write_trace(trace_file);
+    std::cout << "trace of sorting saved to pool_trace.json" << std::endl;
+}
+
+///////////////////////
+/// blocking tasks
+
+void blocking_tasks_demo()
+{
+    ThreadPool thread_pool(2);
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [start] {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // each blocked worker is compensated - CPU-bound tasks do not wait 3s for the files
+    std::vector<TaskFuture<void>> saves;
+    for(int i = 1; i <= 2; ++i)
+        saves.push_back(thread_pool.submit_blocking([i] { save_to_file("data" + std::to_string(i) + ".txt"); }));
+
+    std::vector<TaskFuture<long>> results;
+    for(int i = 0; i < 4; ++i)
+        results.push_back(thread_pool.submit([] { return fib(27); }));
+
+    for(auto& r : results)
+        r.wait();
+    std::cout << "CPU-bound tasks done after " << elapsed_ms() << "ms; threads: " << thread_pool.size() << std::endl;
+
+    for(auto& s : saves)
+        s.wait();
+    std::cout << "blocking tasks done after " << elapsed_ms() << "ms" << std::endl;
+}
+
+///////////////////////
+/// overload
+
+void overload_demo()
+{
+    auto run_burst = [](const std::string& name, const PoolOptions& options) {
+        ThreadPool thread_pool(options);
+
+        std::vector<TaskFuture<void>> results;
+        for(int i = 0; i < 200; ++i)
+            results.push_back(thread_pool.submit([] { std::this_thread::sleep_for(2ms); }));
+
+        int rejected = 0;
+        for(auto& r : results)
+        {
+            try
+            {
+                r.get();
+            }
+            catch(const TaskRejected&)
+            {
+                ++rejected;
+            }
+        }
+
+        auto stats = thread_pool.stats();
+        std::cout << name << " - rejected: " << rejected
+                  << "; queue wait p99: " << std::chrono::duration_cast<std::chrono::milliseconds>(stats.queue_wait_time.percentile(99)).count()
+                  << "ms" << std::endl;
+    };
+
+    PoolOptions options;
+    options.min_threads = options.max_threads = 2;
+
+    run_burst("unbounded", options);
+
+    PoolOptions bounded = options;
+    bounded.max_queue_depth = 8;
+    run_burst("reject above 8 queued", bounded);
+
+    bounded.overload_policy = OverloadPolicy::caller_runs;
+    run_burst("caller runs above 8 queued", bounded);
+
+    PoolOptions codel = options;
+    codel.shed_target = 5ms;
+    codel.shed_interval = 20ms;
+    run_burst("CoDel shedding (target 5ms)", codel);
+}
+
+///////////////////////
+/// pipeline
+
+void pipeline_demo()
+{
+    ThreadPool thread_pool(4);
+
+    int next_line = 0;
+    std::vector<std::string> output;
+
+    // read (serial) -> parse & square (parallel) -> write (serial, in order of reading)
+    auto read_line = make_filter<void, std::string>(StageMode::serial_in_order, [&next_line](FlowControl& fc) {
+        if (next_line == 20)
+        {
+            fc.stop();
+            return std::string{};
+        }
+        return std::to_string(++next_line);
+    });
+
+    auto square = make_filter<std::string, long>(StageMode::parallel, [](const std::string& line) {
+        long x = std::stol(line);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10 * (x % 4)));
+        return x * x;
+    });
+
+    auto write_line = make_filter<long, void>(StageMode::serial_in_order, [&output](long x) {
+        output.push_back(std::to_string(x));
+    });
+
+    parallel_pipeline(thread_pool, 8, read_line & square & write_line);
+
+    std::cout << "pipeline output:";
+    for(const auto& line : output)
+        std::cout << " " << line;
+    std::cout << std::endl;
+}
+
+///////////////////////
+/// shutdown
+
+void shutdown_demo()
+{
+    auto submit_batch = [](ThreadPool& thread_pool) {
+        std::vector<TaskFuture<void>> results;
+        for(int i = 0; i < 10; ++i)
+            results.push_back(thread_pool.submit([] { std::this_thread::sleep_for(100ms); }));
+        return results;
+    };
+
+    auto count_executed = [](std::vector<TaskFuture<void>>& results) {
+        int executed = 0;
+        for(auto& r : results)
+        {
+            try
+            {
+                r.get();
+                ++executed;
+            }
+            catch(const TaskRejected&)
+            {}
+        }
+        return executed;
+    };
+
+    {
+        ThreadPool thread_pool(2);
+        auto results = submit_batch(thread_pool);
+        thread_pool.shutdown(ShutdownMode::drain);
+        std::cout << "drain - executed: " << count_executed(results) << "/10" << std::endl;
+    }
+
+    {
+        ThreadPool thread_pool(2);
+        auto results = submit_batch(thread_pool);
+        std::this_thread::sleep_for(50ms);
+        thread_pool.shutdown(ShutdownMode::cancel_pending);
+        std::cout << "cancel_pending - executed: " << count_executed(results) << "/10" << std::endl;
+    }
+
+    {
+        ThreadPool thread_pool(2);
+        auto results = submit_batch(thread_pool);
+        bool is_drained = thread_pool.shutdown_for(250ms);
+        std::cout << "shutdown_for(250ms) - drained: " << std::boolalpha << is_drained
+                  << "; executed: " << count_executed(results) << "/10" << std::endl;
+    }
+
+    // runners of a bulk submission stop taking indices - shutdown_for() is bounded
+    {
+        ThreadPool thread_pool(2);
+        std::atomic<size_t> executed{0};
+        auto bulk = thread_pool.submit_n(1'000'000, [&executed](size_t) {
+            std::this_thread::sleep_for(10us);
+            ++executed;
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        bool is_drained = thread_pool.shutdown_for(50ms);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+        bool is_cancelled = false;
+        try
+        {
+            bulk.get();
+        }
+        catch(const TaskCancelled&)
+        {
+            is_cancelled = true;
+        }
+
+        std::cout << "shutdown_for(50ms) of 1000000 bulk tasks - drained: " << std::boolalpha << is_drained
+                  << "; executed: " << executed << "; cancelled: " << thread_pool.stats().bulk_items_cancelled
+                  << "; future cancelled: " << is_cancelled << "; " << elapsed << "ms" << std::endl;
+    }
+
+    // wrappers used after shutdown refuse their tasks instead of waiting for them forever
+    {
+        ThreadPool thread_pool(2);
+        thread_pool.shutdown();
+
+        auto is_rejected = [](auto&& use) {
+            try
+            {
+                use();
+            }
+            catch(const TaskRejected&)
+            {
+                return true;
+            }
+            return false;
+        };
+
+        bool task_group = is_rejected([&] {
+            TaskGroup tg{thread_pool};
+            tg.run([] {});
+        });
+
+        bool strand = is_rejected([&] {
+            Strand strand{thread_pool};
+            strand.execute([] {});
+        });
+
+        bool task_graph = is_rejected([&] {
+            TaskGraph graph;
+            graph.emplace([] {});
+            graph.run_and_wait(thread_pool);
+        });
+
+        bool pipeline = is_rejected([&] {
+            auto input = make_filter<void, int>(StageMode::serial_in_order, [](FlowControl& fc) {
+                fc.stop();
+                return 0;
+            });
+            parallel_pipeline(thread_pool, 4, input & make_filter<int, void>(StageMode::parallel, [](int) {}));
+        });
+
+        std::cout << "after shutdown - rejected by task_group: " << std::boolalpha << task_group << "; strand: " << strand
+                  << "; task_graph: " << task_graph << "; pipeline: " << pipeline;
+
+#if defined(__unix__) || defined(__APPLE__)
+        // operations still complete - handlers run in the calling or completion thread
+        int fd = ::open("/dev/zero", O_RDONLY);
+        if (fd >= 0)
+        {
+            AsyncFileIO file_io{thread_pool};
+            char buffer[16];
+            std::cout << "; async_file_io read: " << file_io.read(fd, buffer, sizeof(buffer), 0).get() << " bytes";
+            ::close(fd);
+        }
+#endif
+        std::cout << std::endl;
+    }
+}
+
+///////////////////////
+/// LIFO slot
+
+void lifo_slot_benchmark()
+{
+    std::cout << "lifo_slot_limit,time_ms,lifo_pops,queue_pops" << std::endl;
+
+    for(size_t lifo_slot_limit : {0, 3})
+    {
+        PoolOptions options;
+        options.lifo_slot_limit = lifo_slot_limit;
+
+        ThreadPool thread_pool(options);
+        ChainCounters counters;
+
+        auto time_ms = run_chains(thread_pool, CpuTopology::detect(), counters);
+
+        auto stats = thread_pool.stats();
+        std::cout << lifo_slot_limit << "," << time_ms << ","
+                  << stats.lifo_pops << "," << stats.local_pops + stats.remote_pops << std::endl;
+    }
+}
+
+void bulk_submit_benchmark()
+{
+    const size_t no_of_tasks = 1'000'000;
+
+    std::cout << "submission,time_ms" << std::endl;
+
+    ThreadPool thread_pool(std::thread::hardware_concurrency());
+    std::vector<long> values(no_of_tasks);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        TaskGroup tg{thread_pool};
+        for(size_t i = 0; i < no_of_tasks; ++i)
+            tg.run([&values, i] { values[i] = static_cast<long>(i); });
+        tg.wait();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "one_by_one," << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    thread_pool.submit_n(no_of_tasks, [&values](size_t i) { values[i] = static_cast<long>(i); }).get();
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "submit_n," << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << std::endl;
+
+    std::vector<std::function<void()>> tasks;
+    for(int i = 0; i < 4; ++i)
+        tasks.push_back([i] { if (i == 2) throw std::runtime_error("bulk task failed"); });
+
+    try
+    {
+        thread_pool.submit_bulk(std::move(tasks)).get();
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cout << "submit_bulk: " << e.what() << std::endl;
+    }
+}
+
+///////////////////////
+/// executors
+
+// generic code - runs on any executor
+template <typename Executor>
+long sum_of_squares(Executor& executor, const std::vector<int>& data)
+{
+    std::vector<long> squares(data.size());
+    parallel_for(executor, 0, data.size(), [&](size_t i) { squares[i] = static_cast<long>(data[i]) * data[i]; });
+
+    return executor.submit([&squares] { return std::accumulate(squares.begin(), squares.end(), 0L); }).get();
+}
+
+void executors_demo()
+{
+    std::vector<int> data(100'000);
+    std::iota(data.begin(), data.end(), 0);
+
+    // isolated pools - blocking I/O cannot starve CPU-bound work
+    ThreadPool cpu_pool(std::thread::hardware_concurrency());
+    ThreadPool io_pool(4);
+    Strand log_strand{io_pool};
+    InlineExecutor inline_executor;
+
+    io_pool.execute([] { std::this_thread::sleep_for(200ms); }); // blocking I/O
+
+    std::cout << "inline: " << sum_of_squares(inline_executor, data) << std::endl;
+    std::cout << "cpu_pool: " << sum_of_squares(cpu_pool, data) << std::endl;
+    std::cout << "strand: " << sum_of_squares(log_strand, data) << std::endl;
+}
+
+///////////////////////
+/// async file I/O
+
+#if defined(__unix__) || defined(__APPLE__)
+void async_file_io_demo()
+{
+    const size_t no_of_blocks = 4096;
+    const size_t block_size = 4096;
+
+    ThreadPool thread_pool(2);
+    AsyncFileIO file_io{thread_pool};
+
+    int fd = ::open("async_data.bin", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+
+    // all writes are in flight at once - no worker is blocked
+    std::vector<std::string> blocks(no_of_blocks);
+    std::vector<TaskFuture<size_t>> writes;
+    for(size_t i = 0; i < no_of_blocks; ++i)
+    {
+        blocks[i] = std::string(block_size, static_cast<char>('a' + i % 26));
+        writes.push_back(file_io.write(fd, blocks[i].data(), block_size, static_cast<off_t>(i * block_size)));
+    }
+
+    size_t written = 0;
+    for(auto& w : writes)
+        written += w.get();
+
+    // continuation is executed by a worker
+    std::string first_block(block_size, '\0');
+    std::promise<bool> checked;
+    file_io.async_read(fd, &first_block[0], block_size, 0, [&](std::error_code ec, size_t size) {
+        checked.set_value(!ec && size == block_size && first_block == blocks[0]);
+    });
+
+    bool is_valid = checked.get_future().get();
+    ::close(fd);
+    ::unlink("async_data.bin");
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << (file_io.uses_io_uring() ? "io_uring" : "pread/pwrite") << " - written: " << written
+              << " bytes in " << elapsed << "ms; read back: " << std::boolalpha << is_valid
+              << "; threads: " << thread_pool.size() << std::endl;
+}
+#endif
+
+///////////////////////
+/// fibers
+
+#if defined(THREAD_POOL_FIBERS)
+void fibers_demo()
+{
+    PoolOptions options;
+    options.min_threads = options.max_threads = 2;
+    options.fiber_stack_size = 64 * 1024;
+
+    ThreadPool thread_pool(options);
+    TaskMutex mtx_total{thread_pool};
+    long total = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        // 10'000 tasks wait at once - each waiting task suspends its fiber, not the worker
+        TaskGroup tg{thread_pool};
+        for(int i = 0; i < 10'000; ++i)
+            tg.run([&, i] {
+                auto response = thread_pool.submit_after(100ms, [i] { return i % 10; }); // simulated remote call
+                int value = response.get();
+
+                std::lock_guard<TaskMutex> lk{mtx_total};
+                total += value;
+            });
+        tg.wait();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "fibers - total: " << total << " after " << elapsed << "ms; threads: " << thread_pool.size() << std::endl;
+}
+#endif
+
+///////////////////////
+/// error paths - exceptions vs Expected
+
+enum class ParseError
+{
+    empty,
+    not_a_number
+};
+
+Expected<int, ParseError> parse_number(const std::string& text)
+{
+    if (text.empty())
+        return make_unexpected(ParseError::empty);
+
+    if (!std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; }))
+        return make_unexpected(ParseError::not_a_number);
+
+    return std::stoi(text);
+}
+
+void error_paths_benchmark()
+{
+    const size_t no_of_tasks = 100'000;
+
+    std::vector<std::string> inputs(no_of_tasks);
+    for(size_t i = 0; i < no_of_tasks; ++i)
+        inputs[i] = i % 2 == 0 ? std::to_string(i % 1000) : "n/a"; // every second input fails
+
+    ThreadPool thread_pool(std::thread::hardware_concurrency());
+
+    auto start = std::chrono::steady_clock::now();
+    size_t no_of_exceptions = 0;
+    {
+        TaskGroup tg{thread_pool};
+        for(const auto& input : inputs)
+            tg.run([&input] {
+                if (!parse_number(input))
+                    throw std::invalid_argument("not a number: " + input);
+            });
+
+        try
+        {
+            tg.wait_all();
+        }
+        catch(const AggregateError& e)
+        {
+            no_of_exceptions = e.size();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "exceptions - failures: " << no_of_exceptions << "; "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    size_t no_of_errors = 0;
+    {
+        ExpectedGroup<ParseError> eg{thread_pool};
+        for(const auto& input : inputs)
+            eg.run([&input]() -> Expected<void, ParseError> {
+                auto number = parse_number(input);
+                if (!number)
+                    return make_unexpected(number.error());
+                return {};
+            });
+
+        auto result = eg.wait();
+        if (!result)
+            no_of_errors = result.error().size();
+    }
+    end = std::chrono::steady_clock::now();
+    std::cout << "expected - failures: " << no_of_errors << "; "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
+}
+
+#if defined(__cpp_lib_memory_resource)
+// many small short-lived allocations - nodes of a map
+template <typename Map>
+long scratch_work(Map& scratch, size_t i)
+{
+    for(size_t j = 0; j < 256; ++j)
+        ++scratch[static_cast<long>((i * j) % 1000)];
+    return static_cast<long>(scratch.size());
+}
+
+void worker_arena_benchmark()
+{
+    const size_t no_of_tasks = 20'000;
+
+    std::cout << "scratch_memory,time_ms" << std::endl;
+
+    ThreadPool thread_pool(std::thread::hardware_concurrency());
+    std::atomic<long> checksum{0};
+
+    auto start = std::chrono::high_resolution_clock::now();
+    thread_pool.submit_n(no_of_tasks, [&checksum](size_t i) {
+        std::map<long, int> scratch;
+        checksum += scratch_work(scratch, i);
+    }).get();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "global_allocator," << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    thread_pool.submit_n(no_of_tasks, [&checksum](size_t i) {
+        std::pmr::map<long, int> scratch{ThreadPool::worker_arena()};
+        checksum += scratch_work(scratch, i);
+    }).get();
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "worker_arena," << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << std::endl;
+}
+#endif
+
+void default_pool_demo()
+{
+    std::cout << "available_cpus: " << available_cpus() << ", default_pool_size: " << default_pool_size() << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    prewarm_default_pool();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "default pool of " << default_pool().size() << " workers prewarmed in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+    std::vector<TaskFuture<long>> futures;
+    for(long i = 0; i < 8; ++i)
+        futures.push_back(async_pool([i] { return i * i; }));
+
+    long sum = 0;
+    for(auto& f : futures)
+        sum += f.get();
+
+    std::cout << "sum of squares from async_pool: " << sum << std::endl;
+    std::cout << "configure_default_pool after first use: " << configure_default_pool(PoolOptions{}) << std::endl;
+}
+
+int main()
+{
+    std::cout << "Main thread starts..." << std::endl;
+
+    thread_pool_demo();
+    ref_vs_shared_ptr_demo();
+
+    task_group_demo();
+    nested_futures_demo();
+    elastic_pool_demo();
+    numa_placement_benchmark();
+    cancellation_demo();
+    delayed_tasks_demo();
+    task_graph_demo();
+    priorities_demo();
+    strand_demo();
+    metrics_demo();
+    trace_demo();
+    blocking_tasks_demo();
+    overload_demo();
+    pipeline_demo();
+    shutdown_demo();
+    lifo_slot_benchmark();
+    bulk_submit_benchmark();
+#if defined(__cpp_lib_memory_resource)
+    worker_arena_benchmark();
+#endif
+    executors_demo();
+#if defined(__unix__) || defined(__APPLE__)
+    async_file_io_demo();
+#endif
+#if defined(THREAD_POOL_FIBERS)
+    fibers_demo();
+#endif
+    error_paths_benchmark();
+    default_pool_demo();
+
+    std::cout << "Main thread ends..." << std::endl;
+}
@@ -0,0 +1,44 @@
+#ifndef PARALLEL_FOR_HPP
+#define PARALLEL_FOR_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+#include "executor.hpp"
+
+// default number of chunks per hardware thread - uneven iterations are balanced by idle workers
+constexpr size_t parallel_for_chunks_per_thread = 4;
+
+// Runs f(i) for i in [first, last) on any executor - returns when all iterations are done
+// - range is split into chunks of grain_size iterations (0 - chosen from hardware concurrency),
+//   each chunk is a task of one bulk_execute()
+// - the first exception is rethrown
+template <typename Executor, typename Function>
+void parallel_for(Executor& executor, size_t first, size_t last, Function f, size_t grain_size = 0)
+{
+    static_assert(is_executor<Executor>::value, "parallel_for requires an executor");
+    assert(first <= last);
+
+    const size_t size = last - first;
+    if (size == 0)
+        return;
+
+    if (grain_size == 0)
+    {
+        size_t no_of_chunks = std::max(std::thread::hardware_concurrency(), 1u) * parallel_for_chunks_per_thread;
+        grain_size = std::max<size_t>((size + no_of_chunks - 1) / no_of_chunks, 1);
+    }
+
+    const size_t no_of_chunks = (size + grain_size - 1) / grain_size;
+
+    executor.bulk_execute(no_of_chunks, [&f, first, last, grain_size](size_t chunk) {
+        const size_t chunk_first = first + chunk * grain_size;
+        const size_t chunk_last = std::min(chunk_first + grain_size, last);
+
+        for(size_t i = chunk_first; i < chunk_last; ++i)
+            f(i);
+    }).get();
+}
+
+#endif // PARALLEL_FOR_HPP
@@ -0,0 +1,405 @@
+#ifndef PARALLEL_PIPELINE_HPP
+#define PARALLEL_PIPELINE_HPP
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+enum class StageMode
+{
+    serial_in_order,     // one item at a time, in the order of input
+    serial_out_of_order, // one item at a time, in any order
+    parallel             // many items at once
+};
+
+// passed to the input stage - stop() ends the stream (returned value is ignored)
+class FlowControl
+{
+    bool is_stopped_ = false;
+
+public:
+    void stop()
+    {
+        is_stopped_ = true;
+    }
+
+    bool is_stopped() const
+    {
+        return is_stopped_;
+    }
+};
+
+namespace details
+{
+    struct PipelineItem
+    {
+        virtual ~PipelineItem() = default;
+    };
+
+    template <typename T>
+    struct PipelineValue : PipelineItem
+    {
+        T value;
+
+        explicit PipelineValue(T value) : value{std::move(value)}
+        {}
+    };
+
+    using StageBody = std::function<void(std::unique_ptr<PipelineItem>&, FlowControl&)>;
+
+    struct PipelineStage
+    {
+        StageMode mode;
+        StageBody body;
+    };
+
+    template <typename T>
+    T&& value_of(std::unique_ptr<PipelineItem>& item)
+    {
+        return std::move(static_cast<PipelineValue<T>&>(*item).value);
+    }
+
+    // item in-between stages - In -> Out
+    template <typename In, typename Out, typename F>
+    struct MakeStageBody
+    {
+        static StageBody make(F f)
+        {
+            return [f](std::unique_ptr<PipelineItem>& item, FlowControl&) {
+                item = std::make_unique<PipelineValue<Out>>(f(value_of<In>(item)));
+            };
+        }
+    };
+
+    // input stage - produces items until FlowControl::stop()
+    template <typename Out, typename F>
+    struct MakeStageBody<void, Out, F>
+    {
+        static StageBody make(F f)
+        {
+            return [f](std::unique_ptr<PipelineItem>& item, FlowControl& fc) {
+                Out value = f(fc);
+                if (!fc.is_stopped())
+                    item = std::make_unique<PipelineValue<Out>>(std::move(value));
+            };
+        }
+    };
+
+    // output stage - consumes items
+    template <typename In, typename F>
+    struct MakeStageBody<In, void, F>
+    {
+        static StageBody make(F f)
+        {
+            return [f](std::unique_ptr<PipelineItem>& item, FlowControl&) {
+                f(value_of<In>(item));
+                item.reset();
+            };
+        }
+    };
+
+    // single stage pipeline
+    template <typename F>
+    struct MakeStageBody<void, void, F>
+    {
+        static StageBody make(F f)
+        {
+            return [f](std::unique_ptr<PipelineItem>&, FlowControl& fc) { f(fc); };
+        }
+    };
+
+    class Pipeline;
+}
+
+// Chain of stages transforming In into Out - built with make_filter() and operator&
+template <typename In, typename Out>
+class Filter
+{
+    std::vector<details::PipelineStage> stages_;
+
+    template <typename I, typename O>
+    friend class Filter;
+
+    friend class details::Pipeline;
+
+public:
+    explicit Filter(std::vector<details::PipelineStage> stages) : stages_{std::move(stages)}
+    {}
+
+    template <typename Next>
+    Filter<In, Next> operator&(const Filter<Out, Next>& next) const
+    {
+        auto stages = stages_;
+        stages.insert(stages.end(), next.stages_.begin(), next.stages_.end());
+        return Filter<In, Next>{std::move(stages)};
+    }
+};
+
+// stage of a pipeline:
+// - In = void: input stage - Out f(FlowControl&)
+// - Out = void: output stage - void f(In)
+// - otherwise: Out f(In)
+template <typename In, typename Out, typename F>
+Filter<In, Out> make_filter(StageMode mode, F f)
+{
+    return Filter<In, Out>{{details::PipelineStage{mode, details::MakeStageBody<In, Out, F>::make(std::move(f))}}};
+}
+
+namespace details
+{
+    // Execution of a pipeline - a token is an item travelling through all stages in one task
+    // - a token that cannot enter a serial stage is parked there and resumed by the token leaving the stage
+    // - a token that leaves the last stage takes the next item from the input
+    class Pipeline
+    {
+        struct Token
+        {
+            std::unique_ptr<PipelineItem> item;
+            size_t seq = 0;
+        };
+
+        struct SerialStage
+        {
+            std::mutex mtx;
+            bool is_busy = false;
+            size_t next_seq = 0;                              // serial_in_order
+            std::map<size_t, std::shared_ptr<Token>> waiting; // parked tokens by seq
+        };
+
+        ThreadPool& pool_;
+        const std::vector<PipelineStage>& stages_;
+        std::vector<std::unique_ptr<SerialStage>> serial_stages_;
+
+        std::mutex mtx_input_;
+        bool is_input_done_ = false;
+        size_t next_seq_ = 0;
+
+        std::mutex mtx_;
+        size_t active_tokens_;
+        std::exception_ptr exception_;
+        std::atomic<bool> has_failed_{false};
+        std::condition_variable cv_done_;
+
+        void fail(std::exception_ptr e)
+        {
+            std::lock_guard<std::mutex> lk{mtx_};
+            if (!exception_)
+                exception_ = e;
+            has_failed_ = true;
+        }
+
+        bool next_input(Token& token)
+        {
+            std::lock_guard<std::mutex> lk{mtx_input_};
+
+            if (is_input_done_ || has_failed_)
+                return false;
+
+            FlowControl fc;
+            try
+            {
+                stages_.front().body(token.item, fc);
+            }
+            catch (...)
+            {
+                fail(std::current_exception());
+                fc.stop();
+            }
+
+            if (fc.is_stopped())
+            {
+                is_input_done_ = true;
+                return false;
+            }
+
+            token.seq = next_seq_++;
+            return true;
+        }
+
+        // false if the token was parked
+        bool enter_stage(std::shared_ptr<Token>& token, size_t stage)
+        {
+            if (stages_[stage].mode == StageMode::parallel)
+                return true;
+
+            auto& serial_stage = *serial_stages_[stage];
+            std::lock_guard<std::mutex> lk{serial_stage.mtx};
+
+            bool in_order = stages_[stage].mode == StageMode::serial_in_order;
+
+            if (serial_stage.is_busy || (in_order && token->seq != serial_stage.next_seq))
+            {
+                size_t seq = token->seq;
+                serial_stage.waiting.emplace(seq, std::move(token));
+                return false;
+            }
+
+            serial_stage.is_busy = true;
+            return true;
+        }
+
+        void execute_stage(Token& token, size_t stage)
+        {
+            if (has_failed_)
+            {
+                token.item.reset(); // remaining items only pass through serial stages to keep the order
+                return;
+            }
+
+            try
+            {
+                FlowControl fc;
+                stages_[stage].body(token.item, fc);
+            }
+            catch (...)
+            {
+                fail(std::current_exception());
+                token.item.reset();
+            }
+        }
+
+        // parked token that may enter the stage next is resumed in a new task
+        void leave_stage(size_t stage)
+        {
+            if (stages_[stage].mode == StageMode::parallel)
+                return;
+
+            auto& serial_stage = *serial_stages_[stage];
+            std::shared_ptr<Token> next;
+            {
+                std::lock_guard<std::mutex> lk{serial_stage.mtx};
+
+                auto it = serial_stage.waiting.begin();
+                if (stages_[stage].mode == StageMode::serial_in_order)
+                    it = serial_stage.waiting.find(++serial_stage.next_seq);
+
+                if (it == serial_stage.waiting.end())
+                {
+                    serial_stage.is_busy = false;
+                    return;
+                }
+
+                next = std::move(it->second); // stage stays busy - handed over to the next token
+                serial_stage.waiting.erase(it);
+            }
+
+            pool_.execute([this, next, stage] { resume_token(next, stage); });
+        }
+
+        void run_token(std::shared_ptr<Token> token, size_t stage)
+        {
+            while (true)
+            {
+                for(; stage < stages_.size(); ++stage)
+                {
+                    if (!enter_stage(token, stage))
+                        return;
+
+                    execute_stage(*token, stage);
+                    leave_stage(stage);
+                }
+
+                if (!next_input(*token))
+                {
+                    token_finished();
+                    return;
+                }
+
+                stage = 1;
+            }
+        }
+
+        // token resumed by leave_stage() has already entered the stage
+        void resume_token(std::shared_ptr<Token> token, size_t stage)
+        {
+            execute_stage(*token, stage);
+            leave_stage(stage);
+            run_token(std::move(token), stage + 1);
+        }
+
+        void start_token()
+        {
+            auto token = std::make_shared<Token>();
+
+            if (next_input(*token))
+                run_token(std::move(token), 1);
+            else
+                token_finished();
+        }
+
+        void token_finished()
+        {
+            std::lock_guard<std::mutex> lk{mtx_};
+
+            if (--active_tokens_ == 0)
+                cv_done_.notify_all();
+        }
+
+        bool is_done()
+        {
+            std::lock_guard<std::mutex> lk{mtx_};
+            return active_tokens_ == 0;
+        }
+
+    public:
+        Pipeline(ThreadPool& pool, size_t max_tokens, const Filter<void, void>& filter)
+            : pool_{pool}, stages_{filter.stages_}, active_tokens_{max_tokens}
+        {
+            for(size_t i = 0; i < stages_.size(); ++i)
+                serial_stages_.push_back(stages_[i].mode == StageMode::parallel ? nullptr : std::make_unique<SerialStage>());
+        }
+
+        void run()
+        {
+            const size_t max_tokens = active_tokens_;
+            size_t started_tokens = 0;
+
+            // after shutdown tasks are refused - tokens started before process the whole input
+            while (started_tokens < max_tokens && pool_.try_execute([this] { start_token(); }))
+                ++started_tokens;
+
+            if (started_tokens < max_tokens)
+            {
+                std::lock_guard<std::mutex> lk{mtx_};
+                active_tokens_ -= max_tokens - started_tokens;
+                if (started_tokens == 0)
+                    throw TaskRejected{};
+            }
+
+            if (pool_.is_worker_thread())
+                pool_.help_until([this] { return is_done(); });
+
+            {
+                std::unique_lock<std::mutex> lk{mtx_};
+                cv_done_.wait(lk, [this] { return active_tokens_ == 0; });
+            }
+
+            if (exception_)
+                std::rethrow_exception(exception_);
+        }
+    };
+}
+
+// Runs a chain of stages on the pool - returns when the input is exhausted and all items are processed
+// - at most max_tokens items are in flight, so memory is bounded and the input stage is throttled
+// - input stage (first) is always executed serially in order
+// - the first exception stops the input and is rethrown here
+// - throws TaskRejected after shutdown of the pool (from outside of the pool)
+inline void parallel_pipeline(ThreadPool& pool, size_t max_tokens, const Filter<void, void>& filter)
+{
+    assert(max_tokens > 0);
+
+    details::Pipeline pipeline{pool, max_tokens, filter};
+    pipeline.run();
+}
+
+#endif // PARALLEL_PIPELINE_HPP
@@ -0,0 +1,223 @@
+#ifndef POOL_STATS_HPP
+#define POOL_STATS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Log-linear histogram of durations (HDR-style):
+// - values are grouped by power of two and each group is split into 8 linear sub-buckets
+// - relative error of a recorded value is below 12.5%
+class LatencyHistogram
+{
+public:
+    static constexpr size_t sub_bucket_bits = 3;
+    static constexpr size_t sub_buckets = 1 << sub_bucket_bits;
+    static constexpr size_t no_of_buckets = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+    static size_t bucket_of(uint64_t value)
+    {
+        if (value < sub_buckets)
+            return value;
+
+        size_t magnitude = 63 - count_leading_zeros(value);
+        size_t sub_bucket = (value >> (magnitude - sub_bucket_bits)) & (sub_buckets - 1);
+
+        return (magnitude - sub_bucket_bits + 1) * sub_buckets + sub_bucket;
+    }
+
+    // lowest value stored in the bucket
+    static uint64_t lower_bound_of(size_t bucket)
+    {
+        if (bucket < sub_buckets)
+            return bucket;
+
+        size_t magnitude = bucket / sub_buckets + sub_bucket_bits - 1;
+        size_t sub_bucket = bucket % sub_buckets;
+
+        return (uint64_t{1} << magnitude) | (uint64_t{sub_bucket} << (magnitude - sub_bucket_bits));
+    }
+
+private:
+    static size_t count_leading_zeros(uint64_t value)
+    {
+        size_t n = 0;
+        for(uint64_t mask = uint64_t{1} << 63; (value & mask) == 0; mask >>= 1)
+            ++n;
+        return n;
+    }
+};
+
+// snapshot of a histogram - buckets of many workers are added on read
+struct HistogramSnapshot
+{
+    std::array<uint64_t, LatencyHistogram::no_of_buckets> counts{};
+    uint64_t total_count{};
+
+    // p in range [0, 100]
+    std::chrono::nanoseconds percentile(double p) const
+    {
+        if (total_count == 0)
+            return std::chrono::nanoseconds::zero();
+
+        uint64_t rank = static_cast<uint64_t>(p / 100.0 * (total_count - 1)) + 1;
+        uint64_t seen = 0;
+
+        for(size_t bucket = 0; bucket < counts.size(); ++bucket)
+        {
+            seen += counts[bucket];
+            if (seen >= rank)
+                return std::chrono::nanoseconds{LatencyHistogram::lower_bound_of(bucket)};
+        }
+
+        return std::chrono::nanoseconds{LatencyHistogram::lower_bound_of(counts.size() - 1)};
+    }
+};
+
+struct WorkerStatsSnapshot
+{
+    size_t tasks_executed{};
+    std::chrono::nanoseconds busy_time{};
+    std::chrono::nanoseconds idle_time{};
+};
+
+struct PoolStats
+{
+    size_t tasks_submitted{};
+    size_t tasks_completed{};
+    size_t tasks_failed{};     // finished with exception
+    size_t cancelled_tasks{};  // tasks dropped before start due to requested stop
+    size_t rejected_tasks{};   // tasks refused by admission control or shed from the queue
+    std::chrono::nanoseconds helping_time{}; // time spent by waiting workers on executing other tasks
+    size_t helped_tasks{};
+    size_t threads{};
+    size_t threads_spawned{};  // workers started above min_threads
+    size_t threads_retired{};  // workers stopped after keep_alive of idleness
+    size_t local_pops{};       // tasks taken by workers from the queue of their own NUMA node
+    size_t remote_pops{};      // tasks stolen from queues of other nodes or LIFO slots of other workers
+    size_t lifo_pops{};        // tasks spawned by a worker and executed next by the same worker
+    size_t bulk_items_failed{}; // indices of submit_bulk() / submit_n() that threw - their runner tasks count as completed
+    size_t bulk_items_cancelled{}; // indices of submit_bulk() / submit_n() dropped by shutdown with cancellation
+    std::vector<WorkerStatsSnapshot> workers; // worker slots - a slot of retired worker is reused
+    HistogramSnapshot queue_wait_time;
+    HistogramSnapshot execution_time;
+
+    // single line of JSON
+    void write(std::ostream& out) const
+    {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+
+        auto write_histogram = [&out](const char* name, const HistogramSnapshot& h) {
+            out << "\"" << name << "_us\":{"
+                << "\"p50\":" << duration_cast<microseconds>(h.percentile(50)).count()
+                << ",\"p90\":" << duration_cast<microseconds>(h.percentile(90)).count()
+                << ",\"p99\":" << duration_cast<microseconds>(h.percentile(99)).count()
+                << ",\"max\":" << duration_cast<microseconds>(h.percentile(100)).count() << "}";
+        };
+
+        out << "{\"tasks_submitted\":" << tasks_submitted
+            << ",\"tasks_completed\":" << tasks_completed
+            << ",\"tasks_failed\":" << tasks_failed
+            << ",\"cancelled_tasks\":" << cancelled_tasks
+            << ",\"rejected_tasks\":" << rejected_tasks
+            << ",\"helped_tasks\":" << helped_tasks
+            << ",\"helping_time_us\":" << duration_cast<microseconds>(helping_time).count()
+            << ",\"threads\":" << threads
+            << ",\"threads_spawned\":" << threads_spawned
+            << ",\"threads_retired\":" << threads_retired
+            << ",\"local_pops\":" << local_pops
+            << ",\"remote_pops\":" << remote_pops
+            << ",\"lifo_pops\":" << lifo_pops
+            << ",\"bulk_items_failed\":" << bulk_items_failed
+            << ",\"bulk_items_cancelled\":" << bulk_items_cancelled << ",";
+        write_histogram("queue_wait_time", queue_wait_time);
+        out << ",";
+        write_histogram("execution_time", execution_time);
+        out << ",\"workers\":[";
+        for(size_t i = 0; i < workers.size(); ++i)
+        {
+            out << (i == 0 ? "" : ",")
+                << "{\"tasks_executed\":" << workers[i].tasks_executed
+                << ",\"busy_us\":" << duration_cast<microseconds>(workers[i].busy_time).count()
+                << ",\"idle_us\":" << duration_cast<microseconds>(workers[i].idle_time).count() << "}";
+        }
+        out << "]}\n";
+    }
+};
+
+namespace details
+{
+    // counters updated by a single worker (slot of external threads is shared) - aligned to avoid false sharing
+    struct alignas(128) WorkerStats
+    {
+        using Counter = std::atomic<uint64_t>;
+
+        Counter tasks_submitted{0};
+        Counter tasks_executed{0};
+        Counter tasks_completed{0};
+        Counter tasks_failed{0};
+        Counter tasks_cancelled{0};
+        Counter tasks_rejected{0};
+        Counter helped_tasks{0};
+        Counter helping_time_ns{0};
+        Counter local_pops{0};
+        Counter remote_pops{0};
+        Counter lifo_pops{0};
+        Counter bulk_items_failed{0};
+        Counter bulk_items_cancelled{0};
+        Counter busy_time_ns{0};
+        Counter idle_time_ns{0};
+        std::array<Counter, LatencyHistogram::no_of_buckets> queue_wait_time{};
+        std::array<Counter, LatencyHistogram::no_of_buckets> execution_time{};
+
+        static void increment(Counter& counter, uint64_t value = 1)
+        {
+            counter.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        static void record(std::array<Counter, LatencyHistogram::no_of_buckets>& histogram, std::chrono::nanoseconds value)
+        {
+            increment(histogram[LatencyHistogram::bucket_of(value.count() > 0 ? value.count() : 0)]);
+        }
+
+        void add_to(PoolStats& s) const
+        {
+            auto read = [](const Counter& counter) { return counter.load(std::memory_order_relaxed); };
+
+            s.tasks_submitted += read(tasks_submitted);
+            s.tasks_completed += read(tasks_completed);
+            s.tasks_failed += read(tasks_failed);
+            s.cancelled_tasks += read(tasks_cancelled);
+            s.rejected_tasks += read(tasks_rejected);
+            s.helped_tasks += read(helped_tasks);
+            s.helping_time += std::chrono::nanoseconds{read(helping_time_ns)};
+            s.local_pops += read(local_pops);
+            s.remote_pops += read(remote_pops);
+            s.lifo_pops += read(lifo_pops);
+            s.bulk_items_failed += read(bulk_items_failed);
+            s.bulk_items_cancelled += read(bulk_items_cancelled);
+
+            for(size_t i = 0; i < LatencyHistogram::no_of_buckets; ++i)
+            {
+                s.queue_wait_time.counts[i] += read(queue_wait_time[i]);
+                s.queue_wait_time.total_count += read(queue_wait_time[i]);
+                s.execution_time.counts[i] += read(execution_time[i]);
+                s.execution_time.total_count += read(execution_time[i]);
+            }
+        }
+
+        WorkerStatsSnapshot snapshot() const
+        {
+            return WorkerStatsSnapshot{
+                tasks_executed.load(std::memory_order_relaxed),
+                std::chrono::nanoseconds{busy_time_ns.load(std::memory_order_relaxed)},
+                std::chrono::nanoseconds{idle_time_ns.load(std::memory_order_relaxed)}};
+        }
+    };
+}
+
+#endif // POOL_STATS_HPP
@@ -0,0 +1,135 @@
+#ifndef POOL_TRACE_HPP
+#define POOL_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <utility>
+
+namespace details
+{
+    enum class TraceEventType : uint32_t
+    {
+        task_begin,
+        task_end,
+        steal,   // task taken from a queue of other NUMA node or a LIFO slot of other worker - arg: node
+        sleep,
+        wake,
+        submit   // arg: priority
+    };
+
+    // Ring buffer of trace events - the oldest events are overwritten
+    // - recording is lock-free: one fetch_add and a few relaxed stores
+    // - a slot is versioned with its sequence number, so a reader skips events overwritten while reading
+    class TraceBuffer
+    {
+        struct Event
+        {
+            std::atomic<uint64_t> seq{0}; // index + 1 of the stored event; 0 while it is written
+            std::atomic<int64_t> timestamp{0};
+            std::atomic<uint32_t> type{0};
+            std::atomic<uint32_t> arg{0};
+        };
+
+        std::unique_ptr<Event[]> events_;
+        const uint64_t mask_;
+        std::atomic<uint64_t> head_{0};
+
+        static uint64_t capacity_of(size_t size)
+        {
+            uint64_t capacity = 1;
+            while (capacity < size)
+                capacity <<= 1;
+            return capacity;
+        }
+
+    public:
+        // size is rounded up to power of two
+        explicit TraceBuffer(size_t size) : events_{new Event[capacity_of(size)]}, mask_{capacity_of(size) - 1}
+        {}
+
+        void record(TraceEventType type, uint32_t arg)
+        {
+            auto timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
+
+            uint64_t index = head_.fetch_add(1, std::memory_order_relaxed);
+            Event& e = events_[index & mask_];
+
+            e.seq.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            e.timestamp.store(timestamp, std::memory_order_relaxed);
+            e.type.store(static_cast<uint32_t>(type), std::memory_order_relaxed);
+            e.arg.store(arg, std::memory_order_relaxed);
+            e.seq.store(index + 1, std::memory_order_release);
+        }
+
+        // calls f(type, timestamp, arg) for stored events - from the oldest
+        template <typename F>
+        void for_each(F f) const
+        {
+            uint64_t head = head_.load(std::memory_order_acquire);
+            uint64_t first = head > mask_ + 1 ? head - (mask_ + 1) : 0;
+
+            for(uint64_t index = first; index < head; ++index)
+            {
+                const Event& e = events_[index & mask_];
+
+                if (e.seq.load(std::memory_order_acquire) != index + 1)
+                    continue;
+
+                auto timestamp = e.timestamp.load(std::memory_order_relaxed);
+                auto type = e.type.load(std::memory_order_relaxed);
+                auto arg = e.arg.load(std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (e.seq.load(std::memory_order_relaxed) != index + 1)
+                    continue; // overwritten meanwhile
+
+                f(static_cast<TraceEventType>(type), std::chrono::steady_clock::duration{timestamp}, arg);
+            }
+        }
+    };
+
+    // events of one buffer in Chrome Trace Event format (without enclosing array)
+    // - timestamps in microseconds since start
+    inline void write_trace_events(std::ostream& out, const TraceBuffer& buffer, size_t tid, const char* thread_name,
+                                   std::chrono::steady_clock::time_point start, bool& is_first)
+    {
+        auto separator = [&is_first] { return std::exchange(is_first, false) ? "\n" : ",\n"; };
+
+        out << separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":\"" << thread_name << "\"}}";
+
+        buffer.for_each([&](TraceEventType type, std::chrono::steady_clock::duration timestamp, uint32_t arg) {
+            auto ts = std::chrono::duration<double, std::micro>(timestamp - start.time_since_epoch()).count();
+
+            out << separator() << "{\"pid\":1,\"tid\":" << tid << ",\"ts\":" << std::fixed << ts << std::defaultfloat;
+
+            switch (type)
+            {
+            case TraceEventType::task_begin:
+                out << ",\"name\":\"task\",\"ph\":\"B\"}";
+                break;
+            case TraceEventType::task_end:
+                out << ",\"name\":\"task\",\"ph\":\"E\"}";
+                break;
+            case TraceEventType::steal:
+                out << ",\"name\":\"steal\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"node\":" << arg << "}}";
+                break;
+            case TraceEventType::sleep:
+                out << ",\"name\":\"sleep\",\"ph\":\"B\"}";
+                break;
+            case TraceEventType::wake:
+                out << ",\"name\":\"sleep\",\"ph\":\"E\"}";
+                break;
+            case TraceEventType::submit:
+                out << ",\"name\":\"submit\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"priority\":" << arg << "}}";
+                break;
+            }
+        });
+    }
+}
+
+#endif // POOL_TRACE_HPP
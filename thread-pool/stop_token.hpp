@@ -0,0 +1,60 @@
+#ifndef STOP_TOKEN_HPP
+#define STOP_TOKEN_HPP
+
+#include <atomic>
+#include <memory>
+
+namespace ext
+{
+    // cooperative cancellation - simplified version of C++20 std::stop_source & std::stop_token
+    class stop_token
+    {
+        std::shared_ptr<const std::atomic<bool>> stop_state_;
+
+        friend class stop_source;
+
+        explicit stop_token(std::shared_ptr<const std::atomic<bool>> stop_state)
+            : stop_state_{std::move(stop_state)}
+        {}
+
+    public:
+        stop_token() = default;
+
+        bool stop_possible() const noexcept
+        {
+            return stop_state_ != nullptr;
+        }
+
+        bool stop_requested() const noexcept
+        {
+            return stop_state_ && stop_state_->load(std::memory_order_acquire);
+        }
+    };
+
+    class stop_source
+    {
+        std::shared_ptr<std::atomic<bool>> stop_state_;
+
+    public:
+        stop_source() : stop_state_{std::make_shared<std::atomic<bool>>(false)}
+        {}
+
+        stop_token get_token() const noexcept
+        {
+            return stop_token{stop_state_};
+        }
+
+        // returns true if stop was requested by this call
+        bool request_stop() noexcept
+        {
+            return !stop_state_->exchange(true, std::memory_order_acq_rel);
+        }
+
+        bool stop_requested() const noexcept
+        {
+            return stop_state_->load(std::memory_order_acquire);
+        }
+    };
+}
+
+#endif // STOP_TOKEN_HPP
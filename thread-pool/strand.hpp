@@ -0,0 +1,144 @@
+#ifndef STRAND_HPP
+#define STRAND_HPP
+
+#include <cassert>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <utility>
+
+#include "thread_pool.hpp"
+
+// Serial executor on top of ThreadPool
+// - tasks posted to a strand run one at a time in FIFO order, but on any worker of the pool
+// - replaces a mutex guarding an object: callers queue work instead of blocking
+// - idle strand does not occupy any worker
+class Strand
+{
+    static constexpr size_t max_batch_size = 16; // worker is released after a batch, so strands are fair to others
+
+    ThreadPool& pool_;
+    std::queue<Task> tasks_;
+    bool is_scheduled_ = false;
+    mutable std::mutex mtx_;
+    std::condition_variable cv_idle_;
+
+    // belongs to the running task - in fiber mode it moves with the fiber of the task (fiber.hpp)
+    static const Strand*& current_strand()
+    {
+        static thread_local const Strand* strand = nullptr;
+#if defined(THREAD_POOL_FIBERS)
+        static const bool is_fiber_local = details::FiberLocals::add<const Strand, &Strand::current_strand>();
+        (void)is_fiber_local;
+#endif
+        return strand;
+    }
+
+    void run_batch()
+    {
+        const Strand* prev_strand = current_strand();
+        current_strand() = this;
+
+        for(size_t i = 0; i < max_batch_size; ++i)
+        {
+            Task task;
+            {
+                std::lock_guard<std::mutex> lk{mtx_};
+
+                if (tasks_.empty())
+                {
+                    is_scheduled_ = false;
+                    cv_idle_.notify_all();
+                    current_strand() = prev_strand;
+                    return;
+                }
+
+                task = std::move(tasks_.front());
+                tasks_.pop();
+            }
+
+            task();
+        }
+
+        current_strand() = prev_strand;
+
+        // remaining tasks continue in next batch - scheduled as a new task of the pool
+        pool_.execute([this] { run_batch(); });
+    }
+
+public:
+    explicit Strand(ThreadPool& pool) : pool_{pool}
+    {}
+
+    Strand(const Strand&) = delete;
+    Strand& operator=(const Strand&) = delete;
+
+    // waits until all posted tasks are finished - must not be called from a task of this strand
+    ~Strand()
+    {
+        assert(!running_in_this_thread());
+
+        std::unique_lock<std::mutex> lk{mtx_};
+        cv_idle_.wait(lk, [this] { return !is_scheduled_; });
+    }
+
+    // fire & forget - exceptions must be handled by a task
+    // - throws TaskRejected after shutdown of the pool (from outside of the pool) - queued tasks are dropped
+    void execute(Task task)
+    {
+        assert(task != nullptr);
+
+        bool schedule;
+        {
+            std::lock_guard<std::mutex> lk{mtx_};
+            tasks_.push(std::move(task));
+            schedule = !std::exchange(is_scheduled_, true);
+        }
+
+        if (schedule && !pool_.try_execute([this] { run_batch(); }))
+        {
+            // tasks posted meanwhile by other threads relied on this batch - no worker would run them
+            std::lock_guard<std::mutex> lk{mtx_};
+            tasks_ = {};
+            is_scheduled_ = false;
+            cv_idle_.notify_all();
+            throw TaskRejected{};
+        }
+    }
+
+    template <typename Callable>
+    auto submit(Callable&& callable)
+    {
+        using ResultT = decltype(callable());
+
+        auto pt = std::make_shared<std::packaged_task<ResultT()>>(std::forward<Callable>(callable));
+        TaskFuture<ResultT> f{pt->get_future(), pool_};
+        execute([pt] { (*pt)(); });
+
+        return f;
+    }
+
+    // runs f(0), f(1), ..., f(n - 1) one at a time in order - as a single task of the strand
+    template <typename Function>
+    BulkFuture bulk_execute(size_t n, Function f)
+    {
+        auto state = std::make_shared<details::BulkState>(n, std::move(f), [] {});
+
+        if (n == 0)
+            return BulkFuture{std::move(state), pool_};
+
+        execute([state] { state->run_all(); });
+
+        return BulkFuture{std::move(state), pool_};
+    }
+
+    // true if called from a task of this strand
+    bool running_in_this_thread() const
+    {
+        return current_strand() == this;
+    }
+};
+
+#endif // STRAND_HPP
@@ -0,0 +1,307 @@
+#ifndef TASK_GRAPH_HPP
+#define TASK_GRAPH_HPP
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+// DAG of tasks executed on a ThreadPool
+// - a node is submitted when all of its predecessors are finished (atomic dependency counters)
+// - graph can be run many times - no allocation of nodes between runs
+// - when a node throws, remaining nodes are skipped and wait() rethrows the exception
+// - run() throws std::logic_error if the graph has a cycle (checked after each change of the graph)
+class TaskGraph
+{
+    struct NodeData
+    {
+        Task task;
+        std::string name;
+        std::vector<size_t> successors;
+        size_t no_of_predecessors = 0;
+        std::atomic<size_t> pending_predecessors{0};
+
+        NodeData(Task task, std::string name) : task{std::move(task)}, name{std::move(name)}
+        {}
+    };
+
+    std::deque<NodeData> nodes_;
+    ThreadPool* pool_ = nullptr;
+    std::atomic<size_t> pending_nodes_{0};
+    std::atomic<bool> has_failed_{false};
+    std::exception_ptr exception_;
+    bool is_running_ = false;
+    bool is_acyclic_ = false; // reset by changes of the graph
+    mutable std::mutex mtx_;
+    std::condition_variable cv_done_;
+
+    void execute_node(size_t id)
+    {
+        const size_t no_next = nodes_.size();
+
+        // last ready successor continues in this worker - others are submitted to the pool
+        for(size_t next = id; next != no_next; )
+        {
+            NodeData& node = nodes_[next];
+
+            if (!has_failed_)
+            {
+                try
+                {
+                    node.task();
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lk{mtx_};
+                    if (!exception_)
+                        exception_ = std::current_exception();
+                    has_failed_ = true;
+                }
+            }
+
+            next = no_next;
+
+            for(size_t successor : node.successors)
+            {
+                if (--nodes_[successor].pending_predecessors == 0)
+                {
+                    if (next != no_next)
+                        submit_node(next);
+                    next = successor;
+                }
+            }
+
+            node_finished(); // graph may be destroyed after the last node
+        }
+    }
+
+    void submit_node(size_t id)
+    {
+        pool_->execute([this, id] { execute_node(id); });
+    }
+
+    void node_finished()
+    {
+        if (--pending_nodes_ == 0)
+        {
+            std::lock_guard<std::mutex> lk{mtx_};
+            is_running_ = false;
+            cv_done_.notify_all();
+        }
+    }
+
+    bool is_done() const
+    {
+        std::lock_guard<std::mutex> lk{mtx_};
+        return !is_running_;
+    }
+
+    // Kahn's algorithm - all nodes are visited only if there is no cycle
+    bool has_cycle()
+    {
+        std::vector<size_t> ready;
+        for(size_t id = 0; id < nodes_.size(); ++id)
+        {
+            nodes_[id].pending_predecessors = nodes_[id].no_of_predecessors;
+            if (nodes_[id].no_of_predecessors == 0)
+                ready.push_back(id);
+        }
+
+        size_t visited = 0;
+        while (!ready.empty())
+        {
+            size_t id = ready.back();
+            ready.pop_back();
+            ++visited;
+
+            for(size_t successor : nodes_[id].successors)
+            {
+                if (--nodes_[successor].pending_predecessors == 0)
+                    ready.push_back(successor);
+            }
+        }
+
+        return visited != nodes_.size();
+    }
+
+    // quotes, backslashes & new lines are escaped in DOT labels
+    static void write_escaped(std::ostream& out, const std::string& text)
+    {
+        for(char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out << '\\' << c;
+            else if (c == '\n')
+                out << "\\n";
+            else
+                out << c;
+        }
+    }
+
+public:
+    class Node
+    {
+        TaskGraph* graph_;
+        size_t id_;
+
+        friend class TaskGraph;
+
+        Node(TaskGraph& graph, size_t id) : graph_{&graph}, id_{id}
+        {}
+
+    public:
+        // this node must be finished before other
+        Node& precede(Node other)
+        {
+            assert(graph_ == other.graph_);
+
+            graph_->nodes_[id_].successors.push_back(other.id_);
+            ++graph_->nodes_[other.id_].no_of_predecessors;
+            graph_->is_acyclic_ = false;
+            return *this;
+        }
+
+        // other node must be finished before this one
+        Node& succeed(Node other)
+        {
+            other.precede(*this);
+            return *this;
+        }
+
+        const std::string& name() const
+        {
+            return graph_->nodes_[id_].name;
+        }
+    };
+
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    ~TaskGraph()
+    {
+        std::unique_lock<std::mutex> lk{mtx_};
+        cv_done_.wait(lk, [this] { return !is_running_; });
+    }
+
+    Node emplace(Task task, std::string name = {})
+    {
+        assert(is_done());
+
+        if (name.empty())
+            name = "node#" + std::to_string(nodes_.size());
+
+        nodes_.emplace_back(std::move(task), std::move(name));
+        is_acyclic_ = false;
+        return Node{*this, nodes_.size() - 1};
+    }
+
+    size_t size() const
+    {
+        return nodes_.size();
+    }
+
+    // starts execution - previous run must be finished
+    // - throws TaskRejected after shutdown of the pool (from outside of the pool)
+    void run(ThreadPool& pool)
+    {
+        assert(is_done());
+
+        if (nodes_.empty())
+            return;
+
+        if (!is_acyclic_)
+        {
+            if (has_cycle())
+                throw std::logic_error{"task graph has a cycle"};
+            is_acyclic_ = true;
+        }
+
+        pool_ = &pool;
+        has_failed_ = false;
+        exception_ = nullptr;
+
+        for(auto& node : nodes_)
+            node.pending_predecessors = node.no_of_predecessors;
+
+        pending_nodes_ = nodes_.size();
+        {
+            std::lock_guard<std::mutex> lk{mtx_};
+            is_running_ = true;
+        }
+
+        std::vector<size_t> roots;
+        for(size_t id = 0; id < nodes_.size(); ++id)
+        {
+            if (nodes_[id].no_of_predecessors == 0)
+                roots.push_back(id);
+        }
+
+        // roots are started by a task of the pool - after shutdown the graph either runs completely or not at all
+        bool is_submitted = pool.try_execute([this, roots = std::move(roots)] {
+            for(size_t i = 1; i < roots.size(); ++i)
+                submit_node(roots[i]);
+            execute_node(roots.front());
+        });
+
+        if (!is_submitted)
+        {
+            std::lock_guard<std::mutex> lk{mtx_};
+            is_running_ = false;
+            cv_done_.notify_all();
+            throw TaskRejected{};
+        }
+    }
+
+    // waits for the end of run - a worker of the pool executes other tasks meanwhile
+    void wait()
+    {
+        if (pool_ && pool_->is_worker_thread())
+            pool_->help_until([this] { return is_done(); });
+
+        {
+            std::unique_lock<std::mutex> lk{mtx_};
+            cv_done_.wait(lk, [this] { return !is_running_; });
+        }
+
+        if (exception_)
+            std::rethrow_exception(exception_);
+    }
+
+    void run_and_wait(ThreadPool& pool)
+    {
+        run(pool);
+        wait();
+    }
+
+    // structure of the graph in Graphviz DOT format
+    void dump(std::ostream& out) const
+    {
+        out << "digraph TaskGraph {\n";
+
+        for(size_t id = 0; id < nodes_.size(); ++id)
+        {
+            out << "    n" << id << " [label=\"";
+            write_escaped(out, nodes_[id].name);
+            out << "\"];\n";
+        }
+
+        for(size_t id = 0; id < nodes_.size(); ++id)
+        {
+            for(size_t successor : nodes_[id].successors)
+                out << "    n" << id << " -> n" << successor << ";\n";
+        }
+
+        out << "}\n";
+    }
+};
+
+#endif // TASK_GRAPH_HPP
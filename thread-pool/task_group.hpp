@@ -0,0 +1,193 @@
+#ifndef TASK_GROUP_HPP
+#define TASK_GROUP_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "expected.hpp"
+#include "thread_pool.hpp"
+
+// All failures of a group of tasks - thrown by TaskGroup::wait_all()
+class AggregateError : public std::exception
+{
+    std::vector<std::exception_ptr> exceptions_;
+
+public:
+    explicit AggregateError(std::vector<std::exception_ptr> exceptions) : exceptions_{std::move(exceptions)}
+    {}
+
+    const char* what() const noexcept override
+    {
+        return "one or more tasks failed";
+    }
+
+    const std::vector<std::exception_ptr>& exceptions() const noexcept
+    {
+        return exceptions_;
+    }
+
+    size_t size() const noexcept
+    {
+        return exceptions_.size();
+    }
+};
+
+// Fork-join scope bound to a ThreadPool:
+// - run() spawns subtasks in the pool
+// - wait() blocks until all of them are finished and rethrows the first exception
+// - wait_all() throws AggregateError with exceptions of all failed subtasks
+// A worker that waits for a group executes pending tasks instead of blocking,
+// so nested parallelism (recursive fib, quicksort) does not exhaust the pool.
+class TaskGroup
+{
+    ThreadPool& pool_;
+    size_t pending_tasks_ = 0;
+    std::vector<std::exception_ptr> exceptions_;
+    mutable std::mutex mtx_;
+    std::condition_variable cv_all_done_;
+
+    void task_finished(std::exception_ptr e)
+    {
+        std::lock_guard<std::mutex> lk{mtx_};
+
+        if (e)
+            exceptions_.push_back(e);
+
+        if (--pending_tasks_ == 0)
+            cv_all_done_.notify_all();
+    }
+
+    std::vector<std::exception_ptr> take_exceptions()
+    {
+        std::lock_guard<std::mutex> lk{mtx_};
+        return std::exchange(exceptions_, {});
+    }
+
+    bool is_done() const
+    {
+        std::lock_guard<std::mutex> lk{mtx_};
+        return pending_tasks_ == 0;
+    }
+
+    void wait_for_tasks()
+    {
+        if (pool_.is_worker_thread())
+            pool_.help_until([this] { return is_done(); });
+
+        std::unique_lock<std::mutex> lk{mtx_};
+        cv_all_done_.wait(lk, [this] { return pending_tasks_ == 0; });
+    }
+
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool_{pool}
+    {}
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    ~TaskGroup()
+    {
+        wait_for_tasks(); // subtasks may reference the state of the group - exceptions are ignored here
+    }
+
+    // throws TaskRejected after shutdown of the pool (from outside of the pool)
+    template <typename Callable>
+    void run(Callable&& callable)
+    {
+        {
+            std::lock_guard<std::mutex> lk{mtx_};
+            ++pending_tasks_;
+        }
+
+        bool is_submitted = pool_.try_execute([this, f = std::forward<Callable>(callable)]() mutable {
+            std::exception_ptr e;
+
+            try
+            {
+                f();
+            }
+            catch (...)
+            {
+                e = std::current_exception();
+            }
+
+            task_finished(e);
+        });
+
+        if (!is_submitted)
+        {
+            task_finished(nullptr);
+            throw TaskRejected{};
+        }
+    }
+
+    void wait()
+    {
+        wait_for_tasks();
+
+        std::vector<std::exception_ptr> exceptions = take_exceptions();
+
+        if (!exceptions.empty())
+            std::rethrow_exception(exceptions.front());
+    }
+
+    void wait_all()
+    {
+        wait_for_tasks();
+
+        std::vector<std::exception_ptr> exceptions = take_exceptions();
+
+        if (!exceptions.empty())
+            throw AggregateError{std::move(exceptions)};
+    }
+};
+
+// Fork-join scope for subtasks returning Expected<void, E>
+// - errors are collected as values - error-heavy batches do not pay for throwing & unwinding
+// - wait() returns all errors; exceptions still propagate as in TaskGroup::wait()
+template <typename E>
+class ExpectedGroup
+{
+    std::mutex mtx_;
+    std::vector<E> errors_;
+    TaskGroup tg_; // destroyed first - waits for subtasks using errors_
+
+public:
+    explicit ExpectedGroup(ThreadPool& pool) : tg_{pool}
+    {}
+
+    template <typename Callable>
+    void run(Callable&& callable)
+    {
+        tg_.run([this, f = std::forward<Callable>(callable)]() mutable {
+            Expected<void, E> result = f();
+
+            if (!result)
+            {
+                std::lock_guard<std::mutex> lk{mtx_};
+                errors_.push_back(std::move(result).error());
+            }
+        });
+    }
+
+    Expected<void, std::vector<E>> wait()
+    {
+        tg_.wait();
+
+        std::vector<E> errors;
+        {
+            std::lock_guard<std::mutex> lk{mtx_};
+            std::swap(errors, errors_);
+        }
+
+        if (errors.empty())
+            return {};
+
+        return make_unexpected(std::move(errors));
+    }
+};
+
+#endif // TASK_GROUP_HPP
@@ -0,0 +1,63 @@
+#ifndef TASK_MUTEX_HPP
+#define TASK_MUTEX_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "thread_pool.hpp"
+
+// Mutex for tasks of a ThreadPool (Lockable - usable with std::lock_guard)
+// - a worker waiting for the lock runs other tasks; in fiber mode only the waiting task is suspended
+// - threads outside of the pool block
+// - must be unlocked by the thread that locked it - in fiber mode by the task resumed on the same worker
+// - a worker holding the lock does not run other tasks while it waits (their lock() would deadlock)
+class TaskMutex
+{
+    ThreadPool& pool_;
+    std::atomic<bool> is_locked_{false};
+    std::mutex mtx_;
+    std::condition_variable cv_unlocked_;
+
+public:
+    explicit TaskMutex(ThreadPool& pool) : pool_{pool}
+    {}
+
+    TaskMutex(const TaskMutex&) = delete;
+    TaskMutex& operator=(const TaskMutex&) = delete;
+
+    bool try_lock()
+    {
+        if (is_locked_.exchange(true, std::memory_order_acquire))
+            return false;
+
+        ++ThreadPool::held_task_locks();
+        return true;
+    }
+
+    void lock()
+    {
+        if (try_lock())
+            return;
+
+        if (pool_.is_worker_thread())
+        {
+            pool_.help_until([this] { return try_lock(); });
+            return;
+        }
+
+        std::unique_lock<std::mutex> lk{mtx_};
+        cv_unlocked_.wait(lk, [this] { return try_lock(); });
+    }
+
+    void unlock()
+    {
+        --ThreadPool::held_task_locks();
+        is_locked_.store(false, std::memory_order_release);
+
+        std::lock_guard<std::mutex> lk{mtx_};
+        cv_unlocked_.notify_one();
+    }
+};
+
+#endif // TASK_MUTEX_HPP
@@ -0,0 +1,191 @@
+#ifndef TASK_QUEUE_HPP
+#define TASK_QUEUE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+using Task = std::function<void()>;
+
+enum class Priority
+{
+    high,
+    normal,
+    low
+};
+
+// latest point in time the task should be started at - tasks with deadlines are scheduled EDF
+struct Deadline
+{
+    std::chrono::steady_clock::time_point time;
+};
+
+namespace details
+{
+    struct QueuedTask
+    {
+        Task task;
+        std::chrono::steady_clock::time_point enqueued;
+        Priority priority = Priority::normal;
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        Task reject; // set for tasks with futures - completes the future when the task is shed
+
+        bool has_deadline() const
+        {
+            return deadline != std::chrono::steady_clock::time_point::max();
+        }
+    };
+}
+
+// Queue of tasks of ThreadPool:
+// - tasks with deadlines go first - earliest deadline first
+// - then FIFO lanes for high, normal & low priority
+// - head of a lane is promoted by one priority level per aging_threshold it waits (no starvation)
+//   - equally promoted heads are taken in order of their lanes, so aging never inverts priorities
+//   - a promoted head is taken before tasks with deadlines
+class TaskQueue
+{
+    static constexpr size_t no_of_lanes = 3;
+
+    std::array<std::deque<details::QueuedTask>, no_of_lanes> lanes_;
+    std::vector<details::QueuedTask> deadlines_; // min-heap of deadlines
+    const std::chrono::steady_clock::duration aging_threshold_;
+    mutable std::mutex mtx_;
+
+    static bool later_deadline(const details::QueuedTask& a, const details::QueuedTask& b)
+    {
+        return a.deadline > b.deadline;
+    }
+
+    bool is_empty() const
+    {
+        return deadlines_.empty() && std::all_of(lanes_.begin(), lanes_.end(), [](const auto& lane) { return lane.empty(); });
+    }
+
+    void pop_lane(std::deque<details::QueuedTask>& lane, details::QueuedTask& qt)
+    {
+        qt = std::move(lane.front());
+        lane.pop_front();
+    }
+
+    // number of aging periods the head of a non-empty lane waited
+    long long promotion_of(size_t lane, std::chrono::steady_clock::time_point now) const
+    {
+        return aging_threshold_ > std::chrono::steady_clock::duration::zero() ? (now - lanes_[lane].front().enqueued) / aging_threshold_ : 0;
+    }
+
+public:
+    explicit TaskQueue(std::chrono::steady_clock::duration aging_threshold) : aging_threshold_{aging_threshold}
+    {}
+
+    bool empty() const
+    {
+        std::lock_guard<std::mutex> lk{mtx_};
+        return is_empty();
+    }
+
+    void push(details::QueuedTask qt)
+    {
+        std::lock_guard<std::mutex> lk{mtx_};
+
+        if (qt.has_deadline())
+        {
+            deadlines_.push_back(std::move(qt));
+            std::push_heap(deadlines_.begin(), deadlines_.end(), &later_deadline);
+        }
+        else
+        {
+            lanes_[static_cast<size_t>(qt.priority)].push_back(std::move(qt));
+        }
+    }
+
+    // n copies of the task - with one lock
+    void push_n(const details::QueuedTask& qt, size_t n)
+    {
+        assert(!qt.has_deadline());
+
+        std::lock_guard<std::mutex> lk{mtx_};
+        auto& lane = lanes_[static_cast<size_t>(qt.priority)];
+        lane.insert(lane.end(), n, qt);
+    }
+
+    // true if a task with a deadline or a head above normal priority (also by aging) waits
+    // - such a task is taken before a normal task in the LIFO slot of a worker
+    bool has_urgent_task() const
+    {
+        std::lock_guard<std::mutex> lk{mtx_};
+
+        if (!deadlines_.empty())
+            return true;
+
+        const auto now = std::chrono::steady_clock::now();
+        const size_t normal_lane = static_cast<size_t>(Priority::normal);
+
+        for(size_t i = 0; i < no_of_lanes; ++i)
+        {
+            if (!lanes_[i].empty() && static_cast<long long>(i) - promotion_of(i, now) < static_cast<long long>(normal_lane))
+                return true;
+        }
+
+        return false;
+    }
+
+    bool try_pop(details::QueuedTask& qt)
+    {
+        std::lock_guard<std::mutex> lk{mtx_};
+
+        if (is_empty())
+            return false;
+
+        // aging - level of a lane head is its lane minus number of aging periods it waited
+        const auto now = std::chrono::steady_clock::now();
+        size_t best_lane = no_of_lanes;
+        long long best_level = 0;
+        bool is_promoted = false;
+
+        for(size_t i = 0; i < no_of_lanes; ++i)
+        {
+            if (lanes_[i].empty())
+                continue;
+
+            const long long promotion = promotion_of(i, now);
+            const long long level = static_cast<long long>(i) - promotion;
+
+            if (best_lane == no_of_lanes || level < best_level)
+            {
+                best_lane = i;
+                best_level = level;
+                is_promoted = promotion > 0;
+            }
+        }
+
+        if (is_promoted)
+        {
+            pop_lane(lanes_[best_lane], qt);
+            return true;
+        }
+
+        if (!deadlines_.empty())
+        {
+            std::pop_heap(deadlines_.begin(), deadlines_.end(), &later_deadline);
+            qt = std::move(deadlines_.back());
+            deadlines_.pop_back();
+            return true;
+        }
+
+        if (best_lane != no_of_lanes)
+        {
+            pop_lane(lanes_[best_lane], qt);
+            return true;
+        }
+
+        return false;
+    }
+};
+
+#endif // TASK_QUEUE_HPP
@@ -0,0 +1,1772 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+#include "codel.hpp"
+#include "cpu_topology.hpp"
+#include "fiber.hpp"
+#include "pool_stats.hpp"
+#include "pool_trace.hpp"
+#include "stop_token.hpp"
+#include "task_queue.hpp"
+#include "timer_wheel.hpp"
+#include "worker_arena.hpp"
+
+class ThreadPool;
+class TaskMutex;
+
+// stored in futures of tasks dropped due to requested stop
+class TaskCancelled : public std::runtime_error
+{
+public:
+    TaskCancelled() : std::runtime_error{"task cancelled"}
+    {}
+};
+
+// stored in futures of tasks refused by admission control or shed from an overloaded queue
+class TaskRejected : public std::runtime_error
+{
+public:
+    TaskRejected() : std::runtime_error{"task rejected"}
+    {}
+};
+
+namespace details
+{
+    enum class TaskStatus
+    {
+        completed,
+        failed,
+        cancelled,
+        rejected
+    };
+
+    template <typename Callable>
+    auto invoke_with_token(Callable& callable, const ext::stop_token& token, int) -> decltype(callable(token))
+    {
+        return callable(token);
+    }
+
+    template <typename Callable>
+    auto invoke_with_token(Callable& callable, const ext::stop_token&, long) -> decltype(callable())
+    {
+        return callable();
+    }
+
+    // on_finished is called between the call & completion of the promise
+    template <typename T, typename Callable, typename OnFinished>
+    void set_promise_value(std::promise<T>& promise, Callable& callable, const ext::stop_token& token, OnFinished& on_finished)
+    {
+        T value = invoke_with_token(callable, token, 0);
+        on_finished(TaskStatus::completed);
+        promise.set_value(std::forward<T>(value));
+    }
+
+    template <typename Callable, typename OnFinished>
+    void set_promise_value(std::promise<void>& promise, Callable& callable, const ext::stop_token& token, OnFinished& on_finished)
+    {
+        invoke_with_token(callable, token, 0);
+        on_finished(TaskStatus::completed);
+        promise.set_value();
+    }
+
+    // task that passes its result or exception to a future
+    // - it is dropped (completed with TaskCancelled) if stop is requested before it starts
+    // - status of the task is passed to on_finished before the future becomes ready
+    template <typename T, typename Callable>
+    class PromiseTask
+    {
+        Callable callable_;
+        ext::stop_token token_;
+        std::promise<T> promise_;
+
+    public:
+        PromiseTask(Callable callable, ext::stop_token token)
+            : callable_{std::move(callable)}, token_{std::move(token)}
+        {}
+
+        std::future<T> get_future()
+        {
+            return promise_.get_future();
+        }
+
+        template <typename OnFinished>
+        void operator()(OnFinished on_finished)
+        {
+            if (token_.stop_requested())
+            {
+                on_finished(TaskStatus::cancelled);
+                promise_.set_exception(std::make_exception_ptr(TaskCancelled{}));
+                return;
+            }
+
+            try
+            {
+                set_promise_value(promise_, callable_, token_, on_finished);
+            }
+            catch (...)
+            {
+                on_finished(TaskStatus::failed);
+                promise_.set_exception(std::current_exception());
+            }
+        }
+
+        template <typename OnFinished>
+        void reject(OnFinished on_finished)
+        {
+            on_finished(TaskStatus::rejected);
+            promise_.set_exception(std::make_exception_ptr(TaskRejected{}));
+        }
+    };
+}
+
+// Future returned by ThreadPool::submit()
+// - wait() & get() called from a worker of the pool execute other queued tasks
+//   until the result is ready, so nested submissions cannot starve the pool
+template <typename T>
+class TaskFuture
+{
+    std::future<T> future_;
+    ThreadPool* pool_ = nullptr;
+
+public:
+    TaskFuture() = default;
+
+    TaskFuture(std::future<T> future, ThreadPool& pool)
+        : future_{std::move(future)}, pool_{&pool}
+    {}
+
+    // not bound to a pool - waiting never helps
+    explicit TaskFuture(std::future<T> future) : future_{std::move(future)}
+    {}
+
+    bool valid() const noexcept
+    {
+        return future_.valid();
+    }
+
+    bool is_ready() const
+    {
+        return future_.wait_for(std::chrono::seconds::zero()) == std::future_status::ready;
+    }
+
+    void wait() const;
+
+    template <typename Rep, typename Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeout) const
+    {
+        return future_.wait_for(timeout);
+    }
+
+    T get()
+    {
+        wait();
+        return future_.get();
+    }
+};
+
+// Future returned by ThreadPool::submit_at() & submit_after()
+// - cancel() removes the task from the timer in O(1) - its future throws TaskCancelled
+template <typename T>
+class DelayedFuture : public TaskFuture<T>
+{
+    TimerHandle timer_;
+    ext::stop_source stop_;
+    Task cancelled_task_; // completes the future with TaskCancelled
+
+public:
+    DelayedFuture() = default;
+
+    DelayedFuture(TaskFuture<T> future, TimerHandle timer, ext::stop_source stop, Task cancelled_task)
+        : TaskFuture<T>{std::move(future)}, timer_{std::move(timer)}, stop_{std::move(stop)}, cancelled_task_{std::move(cancelled_task)}
+    {}
+
+    // returns false if the task was already due - it is still dropped if it has not started yet
+    bool cancel()
+    {
+        stop_.request_stop();
+
+        if (!timer_.cancel())
+            return false;
+
+        cancelled_task_();
+        return true;
+    }
+};
+
+namespace details
+{
+    // state shared by runner tasks of submit_bulk() / submit_n()
+    // - runners claim indices of the body from an atomic counter until all of them are taken
+    // - indices not started when the pool cancels pending tasks are dropped - the future throws TaskCancelled
+    class BulkState
+    {
+        const size_t size_;
+        const std::function<void(size_t)> body_;
+        const std::function<void()> on_failure_;
+        std::atomic<size_t> next_index_{0};
+        std::atomic<size_t> pending_indices_;
+        std::exception_ptr first_exception_;
+        bool is_done_;
+        mutable std::mutex mtx_;
+        mutable std::condition_variable cv_done_;
+
+        void indices_finished(size_t count)
+        {
+            if (pending_indices_.fetch_sub(count) == count)
+            {
+                std::lock_guard<std::mutex> lk{mtx_};
+                is_done_ = true;
+                cv_done_.notify_all();
+            }
+        }
+
+        // index claimed by the caller & all indices not claimed yet - returns their number
+        size_t cancel_remaining()
+        {
+            const size_t next_index = next_index_.exchange(size_);
+            const size_t count = 1 + (next_index < size_ ? size_ - next_index : 0);
+
+            {
+                std::lock_guard<std::mutex> lk{mtx_};
+                if (!first_exception_)
+                    first_exception_ = std::make_exception_ptr(TaskCancelled{});
+            }
+
+            indices_finished(count);
+            return count;
+        }
+
+    public:
+        BulkState(size_t size, std::function<void(size_t)> body, std::function<void()> on_failure)
+            : size_{size}, body_{std::move(body)}, on_failure_{std::move(on_failure)}, pending_indices_{size}, is_done_{size == 0}
+        {}
+
+        // runs the body for claimed indices until none is left - an exception does not stop the runner
+        // - once *is_cancelling is set, remaining indices are dropped - returns their number
+        size_t run_all(const std::atomic<bool>* is_cancelling = nullptr)
+        {
+            for(size_t index = next_index_++; index < size_; index = next_index_++)
+            {
+                if (is_cancelling && *is_cancelling)
+                    return cancel_remaining();
+
+                try
+                {
+                    body_(index);
+                }
+                catch (...)
+                {
+                    on_failure_();
+
+                    std::lock_guard<std::mutex> lk{mtx_};
+                    if (!first_exception_)
+                        first_exception_ = std::current_exception();
+                }
+
+                indices_finished(1);
+            }
+
+            return 0;
+        }
+
+        bool is_done() const
+        {
+            std::lock_guard<std::mutex> lk{mtx_};
+            return is_done_;
+        }
+
+        void wait() const
+        {
+            std::unique_lock<std::mutex> lk{mtx_};
+            cv_done_.wait(lk, [this] { return is_done_; });
+        }
+
+        template <typename Clock, typename Duration>
+        bool wait_until(const std::chrono::time_point<Clock, Duration>& deadline) const
+        {
+            std::unique_lock<std::mutex> lk{mtx_};
+            return cv_done_.wait_until(lk, deadline, [this] { return is_done_; });
+        }
+
+        std::exception_ptr first_exception() const
+        {
+            std::lock_guard<std::mutex> lk{mtx_};
+            return first_exception_;
+        }
+    };
+}
+
+// Completion of all tasks of ThreadPool::submit_bulk() / submit_n()
+// - get() rethrows the first exception thrown by the tasks
+// - wait() & get() called from a worker execute other queued tasks meanwhile
+class BulkFuture
+{
+    std::shared_ptr<details::BulkState> state_;
+    ThreadPool* pool_ = nullptr;
+
+public:
+    BulkFuture() = default;
+
+    BulkFuture(std::shared_ptr<details::BulkState> state, ThreadPool& pool)
+        : state_{std::move(state)}, pool_{&pool}
+    {}
+
+    // not bound to a pool - waiting never helps
+    explicit BulkFuture(std::shared_ptr<details::BulkState> state) : state_{std::move(state)}
+    {}
+
+    bool valid() const noexcept
+    {
+        return state_ != nullptr;
+    }
+
+    bool is_ready() const
+    {
+        return state_->is_done();
+    }
+
+    void wait() const;
+
+    template <typename Rep, typename Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeout) const
+    {
+        return state_->wait_until(std::chrono::steady_clock::now() + timeout) ? std::future_status::ready : std::future_status::timeout;
+    }
+
+    void get() const
+    {
+        wait();
+
+        if (auto e = state_->first_exception())
+            std::rethrow_exception(e);
+    }
+};
+
+enum class ShutdownMode
+{
+    drain,         // queued tasks (and tasks submitted by them) are executed
+    cancel_pending // queued tasks with futures are completed with TaskRejected
+};
+
+// what submit() does when max_queue_depth tasks are queued
+enum class OverloadPolicy
+{
+    reject,      // future of the task throws TaskRejected
+    caller_runs  // task is executed by the submitting thread (back-pressure)
+};
+
+enum class Placement
+{
+    none,     // workers are not pinned - single task queue
+    compact,  // workers fill cpus of one NUMA node before the next one
+    scatter,  // workers are spread round-robin across NUMA nodes
+    cpu_list  // workers are pinned to PoolOptions::cpus
+};
+
+struct PoolOptions
+{
+    size_t min_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t max_threads = min_threads;
+    std::chrono::milliseconds keep_alive{10'000};     // idle time after which extra worker is retired
+    size_t spawn_queue_depth = 1;                     // spawn when so many tasks wait and no worker is idle
+    std::chrono::milliseconds spawn_wait_time{100};   // spawn when a task waited longer in the queue
+    Placement placement = Placement::none;            // pinned workers get a task queue per NUMA node
+    std::vector<int> cpus;                            // used by Placement::cpu_list
+    std::chrono::milliseconds aging_threshold{100};   // queued task is promoted by a priority level per this wait - 0 disables aging
+    size_t trace_buffer_size = 0;                     // events kept per worker for write_trace() - 0 disables tracing
+    size_t max_blocking_threads = 16;                 // workers compensating blocked ones - above max_threads
+    size_t max_queue_depth = std::numeric_limits<size_t>::max(); // admission limit of submit() - see overload_policy
+    OverloadPolicy overload_policy = OverloadPolicy::reject;
+    std::chrono::milliseconds shed_target{0};         // CoDel: tasks are shed when queue wait stays above target - 0 disables
+    std::chrono::milliseconds shed_interval{100};     // CoDel: how long queue wait must stay above target before shedding
+    size_t lifo_slot_limit = 3;                       // consecutive tasks taken by a worker from its LIFO slot - 0 disables the slot
+    std::chrono::microseconds lifo_steal_delay{20};   // task in LIFO slot of a busy worker is taken by others after this time
+    size_t worker_arena_size = 64 * 1024;             // initial size of arena of a worker (C++17) - 0 disables arenas, as do fibers
+    size_t fiber_stack_size = 0;                      // tasks run on fibers with stacks of this size (THREAD_POOL_FIBERS builds) - 0 disables fibers
+    std::chrono::microseconds fiber_poll_interval{100}; // idle worker checks its suspended fibers so often
+    std::chrono::microseconds help_wait_interval{100};  // waiting worker without tasks to help checks the result so often
+};
+
+class ThreadPool
+{
+    using QueuedTask = details::QueuedTask;
+
+    friend class TaskMutex;
+
+    static constexpr size_t help_spin_limit = 64; // failed attempts to help before a waiting worker sleeps
+
+    const PoolOptions options_;
+    std::map<size_t, std::thread> threads_;
+    std::vector<std::thread> retired_threads_;
+    std::vector<size_t> free_stats_slots_;
+    size_t used_stats_slots_ = 0;
+    size_t next_worker_id_ = 0;
+    size_t blocked_workers_ = 0;
+    std::atomic<size_t> excess_threads_{0}; // compensating workers to retire after blocking regions end
+    size_t alive_workers_ = 0; // includes retired workers that have not exited yet
+    bool is_stopping_ = false;
+    std::condition_variable cv_worker_exited_;
+    mutable std::mutex mtx_threads_;
+
+    struct NodeQueue
+    {
+        TaskQueue tasks;
+        std::condition_variable cv_tasks;
+        size_t idle_workers = 0; // guarded by mtx_idle_
+
+        explicit NodeQueue(std::chrono::milliseconds aging_threshold) : tasks{aging_threshold}
+        {}
+    };
+
+    // "next task" of a worker - the task spawned last by a worker runs next on it, with warm caches
+    struct LifoSlot
+    {
+        std::mutex mtx;
+        QueuedTask qt;
+        size_t node = 0; // NUMA node of the worker using the slot
+        std::atomic<bool> is_full{false}; // modified with mtx locked - read without lock as a hint
+    };
+
+    std::vector<std::unique_ptr<LifoSlot>> lifo_slots_; // indexed as worker_stats_
+
+#if defined(__cpp_lib_memory_resource)
+    std::vector<std::unique_ptr<WorkerArena>> worker_arenas_; // indexed as worker_stats_ - empty if disabled
+
+    static WorkerArena*& current_arena()
+    {
+        static thread_local WorkerArena* arena = nullptr;
+        return arena;
+    }
+
+    // memory of the finished task is released - tasks executed while helping share the arena with the waiting one
+    static void reset_arena()
+    {
+        WorkerArena* arena = current_arena();
+        if (arena && arena->used() > 0)
+            arena->reset();
+    }
+
+    // memory allocated from the worker arena in the scope is released at its end
+    class ArenaScope
+    {
+        WorkerArena* arena_ = current_arena();
+        WorkerArena::Mark mark_ = arena_ ? arena_->mark() : WorkerArena::Mark{};
+
+    public:
+        ArenaScope() = default;
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+
+        ~ArenaScope()
+        {
+            if (arena_)
+                arena_->rewind(mark_);
+        }
+    };
+#endif
+
+    const CpuTopology topology_;
+    std::vector<int> cpus_;
+    std::vector<std::unique_ptr<NodeQueue>> node_queues_;
+    std::atomic<size_t> queued_tasks_{0};
+    std::atomic<size_t> idle_workers_{0};
+    std::mutex mtx_idle_;
+
+    std::unique_ptr<CoDel> shedding_; // null if shedding is disabled
+    std::atomic<bool> is_shutdown_{false};   // workers exit when the queue is empty
+    std::atomic<bool> is_cancelling_{false}; // queued tasks with futures are rejected
+    std::atomic<size_t> threads_spawned_{0};
+    std::atomic<size_t> threads_retired_{0};
+
+    // slot of a retired worker is taken over by the next spawned one
+    std::vector<std::unique_ptr<details::WorkerStats>> worker_stats_;
+    details::WorkerStats external_stats_; // shared by threads outside of the pool
+
+    // trace buffers - indexed as worker_stats_
+    std::vector<std::unique_ptr<details::TraceBuffer>> worker_traces_;
+    std::unique_ptr<details::TraceBuffer> external_trace_;
+    const std::chrono::steady_clock::time_point trace_start_ = std::chrono::steady_clock::now();
+
+    std::unique_ptr<TimerWheel> timers_;
+    bool are_timers_stopped_ = false; // timers cannot be scheduled after shutdown
+    std::mutex mtx_timers_;
+
+    static ThreadPool*& current_pool()
+    {
+        static thread_local ThreadPool* pool = nullptr;
+        return pool;
+    }
+
+    // index of NUMA node (and its queue) of the worker
+    static size_t& current_node()
+    {
+        static thread_local size_t node = 0;
+        return node;
+    }
+
+    static details::WorkerStats*& current_stats()
+    {
+        static thread_local details::WorkerStats* stats = nullptr;
+        return stats;
+    }
+
+    details::WorkerStats& local_stats()
+    {
+        return is_worker_thread() ? *current_stats() : external_stats_;
+    }
+
+    static LifoSlot*& current_lifo_slot()
+    {
+        static thread_local LifoSlot* slot = nullptr;
+        return slot;
+    }
+
+    // tasks taken in a row from the LIFO slot - reset by every task taken from elsewhere
+    static size_t& lifo_hits()
+    {
+        static thread_local size_t hits = 0;
+        return hits;
+    }
+
+    bool uses_lifo_slot() const
+    {
+        return options_.lifo_slot_limit > 0 && is_worker_thread();
+    }
+
+    // task previously stored in the slot is moved to the queue
+    bool try_push_lifo(QueuedTask& qt)
+    {
+        if (!uses_lifo_slot() || qt.priority != Priority::normal || qt.has_deadline())
+            return false;
+
+        LifoSlot& slot = *current_lifo_slot();
+        QueuedTask prev_qt;
+        bool had_task;
+
+        ++queued_tasks_;
+        {
+            std::lock_guard<std::mutex> lk{slot.mtx};
+            had_task = slot.is_full;
+            if (had_task)
+                prev_qt = std::move(slot.qt);
+            slot.qt = std::move(qt);
+            slot.is_full = true;
+        }
+
+        if (had_task)
+            node_queues_[current_node()]->tasks.push(std::move(prev_qt));
+
+        // idle worker takes the task if this one stays busy longer than lifo_steal_delay
+        if (idle_workers_ > 0)
+            wake_worker(current_node());
+
+        return true;
+    }
+
+    // after lifo_slot_limit hits the task is moved to the back of the queue - queued tasks are not starved
+    // - the slot is skipped while the queue of the node has a task of higher priority or with a deadline
+    bool try_pop_lifo(QueuedTask& qt)
+    {
+        if (!uses_lifo_slot())
+            return false;
+
+        LifoSlot& slot = *current_lifo_slot();
+        if (!slot.is_full || node_queues_[current_node()]->tasks.has_urgent_task())
+            return false;
+
+        std::lock_guard<std::mutex> lk{slot.mtx};
+
+        if (!slot.is_full)
+            return false;
+
+        if (lifo_hits() == options_.lifo_slot_limit)
+        {
+            lifo_hits() = 0;
+            node_queues_[current_node()]->tasks.push(std::move(slot.qt));
+            slot.is_full = false;
+            return false;
+        }
+
+        ++lifo_hits();
+        qt = std::move(slot.qt);
+        slot.is_full = false;
+        --queued_tasks_;
+        details::WorkerStats::increment(local_stats().lifo_pops);
+        return true;
+    }
+
+    // takes a task that waits too long in LIFO slot of other (busy) worker
+    bool try_steal_lifo(QueuedTask& qt)
+    {
+        if (options_.lifo_slot_limit == 0)
+            return false;
+
+        const auto stale = std::chrono::steady_clock::now() - options_.lifo_steal_delay;
+
+        for(auto& slot : lifo_slots_)
+        {
+            if (!slot->is_full || slot.get() == current_lifo_slot())
+                continue;
+
+            std::unique_lock<std::mutex> lk{slot->mtx, std::try_to_lock};
+
+            if (lk.owns_lock() && slot->is_full && slot->qt.enqueued < stale)
+            {
+                qt = std::move(slot->qt);
+                slot->is_full = false;
+                --queued_tasks_;
+                details::WorkerStats::increment(local_stats().remote_pops);
+                trace(details::TraceEventType::steal, static_cast<uint32_t>(slot->node));
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // task of the slot is moved to the queue - when the worker blocks or exits
+    void flush_lifo()
+    {
+        if (!uses_lifo_slot())
+            return;
+
+        LifoSlot& slot = *current_lifo_slot();
+        {
+            std::lock_guard<std::mutex> lk{slot.mtx};
+
+            if (!slot.is_full)
+                return;
+
+            node_queues_[current_node()]->tasks.push(std::move(slot.qt));
+            slot.is_full = false;
+        }
+
+        if (idle_workers_ > 0)
+            wake_worker(current_node());
+    }
+
+#if defined(THREAD_POOL_FIBERS)
+    static details::FiberScheduler*& current_fibers()
+    {
+        static thread_local details::FiberScheduler* fibers = nullptr;
+        return fibers;
+    }
+#endif
+
+    bool uses_fibers() const
+    {
+#if defined(THREAD_POOL_FIBERS)
+        return options_.fiber_stack_size > 0;
+#else
+        return false;
+#endif
+    }
+
+    static bool has_suspended_fibers()
+    {
+#if defined(THREAD_POOL_FIBERS)
+        return current_fibers() && current_fibers()->has_suspended();
+#else
+        return false;
+#endif
+    }
+
+    // TaskMutex locks held by the thread - while any is held, waiting worker does not run other tasks:
+    // such a task could wait for the same lock below the holder on the stack (deadlock)
+    static size_t& held_task_locks()
+    {
+        static thread_local size_t locks = 0;
+        return locks;
+    }
+
+    static details::TraceBuffer*& current_trace()
+    {
+        static thread_local details::TraceBuffer* trace = nullptr;
+        return trace;
+    }
+
+    void trace(details::TraceEventType type, uint32_t arg = 0)
+    {
+        if (options_.trace_buffer_size == 0)
+            return;
+
+        (is_worker_thread() ? current_trace() : external_trace_.get())->record(type, arg);
+    }
+
+    std::vector<int> placement_cpus() const
+    {
+        switch (options_.placement)
+        {
+        case Placement::compact:
+            return topology_.compact_order();
+        case Placement::scatter:
+            return topology_.scatter_order();
+        case Placement::cpu_list:
+            return options_.cpus;
+        default:
+            return {};
+        }
+    }
+
+    // cpu is chosen by the slot of the worker - a worker spawned after retirement takes the place of the retired one
+    size_t pin_worker(size_t stats_slot)
+    {
+        if (cpus_.empty())
+            return 0;
+
+        int cpu = cpus_[stats_slot % cpus_.size()];
+        pin_current_thread(cpu);
+
+        return std::min(topology_.node_index_of(cpu), node_queues_.size() - 1);
+    }
+
+    size_t submit_node() const
+    {
+        if (node_queues_.size() == 1)
+            return 0;
+
+        if (is_worker_thread())
+            return current_node();
+
+        return std::min(topology_.node_index_of(current_cpu()), node_queues_.size() - 1);
+    }
+
+    // own node first - other nodes are visited only when it is empty
+    bool try_pop_queued(QueuedTask& qt)
+    {
+        if (try_pop_lifo(qt))
+            return true;
+
+        const size_t home = is_worker_thread() ? current_node() : 0;
+
+        for(size_t i = 0; i < node_queues_.size(); ++i)
+        {
+            auto& node_queue = *node_queues_[(home + i) % node_queues_.size()];
+
+            if (node_queue.tasks.try_pop(qt))
+            {
+                --queued_tasks_;
+                details::WorkerStats::increment(i == 0 ? local_stats().local_pops : local_stats().remote_pops);
+                if (i != 0)
+                    trace(details::TraceEventType::steal, static_cast<uint32_t>((home + i) % node_queues_.size()));
+                lifo_hits() = 0;
+                return true;
+            }
+        }
+
+        if (!try_steal_lifo(qt))
+            return false;
+
+        lifo_hits() = 0;
+        return true;
+    }
+
+    bool try_pop_task(QueuedTask& qt)
+    {
+        while (try_pop_queued(qt))
+        {
+            if (!is_cancelling_ && !should_shed(qt))
+                return true;
+
+            if (!qt.reject)
+                return true; // fire & forget tasks are never dropped - others may wait for them
+
+            qt.reject();
+        }
+
+        return false;
+    }
+
+    // only tasks with futures are shed - fire & forget tasks may be continuations of groups, graphs or strands
+    bool should_shed(const QueuedTask& qt)
+    {
+        if (!shedding_ || !qt.reject)
+            return false;
+
+        auto now = std::chrono::steady_clock::now();
+        return shedding_->should_drop(now - qt.enqueued, now, queued_tasks_ == 0);
+    }
+
+    // returns false if no task arrived during timeout
+    // - with wake_on_shutdown the worker returns immediately once the pool is shut down
+    bool wait_for_tasks(std::chrono::steady_clock::duration timeout, bool wake_on_shutdown = true)
+    {
+        auto& node_queue = *node_queues_[current_node()];
+
+        std::unique_lock<std::mutex> lk{mtx_idle_};
+
+        ++idle_workers_;
+        ++node_queue.idle_workers;
+        bool has_tasks = node_queue.cv_tasks.wait_for(lk, timeout, [this, wake_on_shutdown] {
+            return queued_tasks_ > 0 || (wake_on_shutdown && is_shutdown_);
+        });
+        --node_queue.idle_workers;
+        --idle_workers_;
+
+        return has_tasks;
+    }
+
+    // wakes up idle worker - preferably from the node of a queued task
+    void wake_worker(size_t node)
+    {
+        std::lock_guard<std::mutex> lk{mtx_idle_};
+
+        for(size_t i = 0; i < node_queues_.size(); ++i)
+        {
+            auto& node_queue = *node_queues_[(node + i) % node_queues_.size()];
+
+            if (node_queue.idle_workers > 0)
+            {
+                node_queue.cv_tasks.notify_one();
+                return;
+            }
+        }
+    }
+
+    // wakes up to count idle workers
+    void wake_workers(size_t node, size_t count)
+    {
+        std::lock_guard<std::mutex> lk{mtx_idle_};
+
+        for(size_t i = 0; i < node_queues_.size() && count > 0; ++i)
+        {
+            auto& node_queue = *node_queues_[(node + i) % node_queues_.size()];
+
+            for(size_t j = std::min(count, node_queue.idle_workers); j > 0; --j, --count)
+                node_queue.cv_tasks.notify_one();
+        }
+    }
+
+    void enqueue(QueuedTask qt, size_t node)
+    {
+        ++queued_tasks_; // counted before the task can be taken - the counter never drops below zero
+        node_queues_[node]->tasks.push(std::move(qt));
+
+        if (idle_workers_ > 0)
+            wake_worker(node);
+    }
+
+    // returns execution time of the task
+    std::chrono::nanoseconds run_task(QueuedTask& qt, std::chrono::steady_clock::time_point start)
+    {
+        auto& stats = local_stats();
+        details::WorkerStats::record(stats.queue_wait_time, start - qt.enqueued);
+
+        trace(details::TraceEventType::task_begin);
+        qt.task(); // execution of task
+        trace(details::TraceEventType::task_end);
+
+        // outcome of a task with a future is recorded by the task itself, before its future is ready
+        if (!qt.reject)
+            task_finished(details::TaskStatus::completed);
+
+        auto execution_time = std::chrono::steady_clock::now() - start;
+        details::WorkerStats::record(stats.execution_time, execution_time);
+        details::WorkerStats::increment(stats.tasks_executed);
+
+        return execution_time;
+    }
+
+    void run(size_t worker_id, size_t stats_slot)
+    {
+        using std::chrono::steady_clock;
+
+        auto& stats = *worker_stats_[stats_slot];
+
+        current_pool() = this;
+        current_stats() = &stats;
+        current_lifo_slot() = lifo_slots_[stats_slot].get();
+        current_trace() = options_.trace_buffer_size > 0 ? worker_traces_[stats_slot].get() : nullptr;
+        current_node() = pin_worker(stats_slot);
+        {
+            std::lock_guard<std::mutex> lk{current_lifo_slot()->mtx};
+            current_lifo_slot()->node = current_node();
+        }
+#if defined(__cpp_lib_memory_resource)
+        current_arena() = worker_arenas_.empty() ? nullptr : worker_arenas_[stats_slot].get();
+#endif
+#if defined(THREAD_POOL_FIBERS)
+        std::unique_ptr<details::FiberScheduler> fibers;
+        if (options_.fiber_stack_size > 0)
+            fibers = std::make_unique<details::FiberScheduler>(options_.fiber_stack_size);
+        current_fibers() = fibers.get();
+#endif
+
+        while(true)
+        {
+#if defined(THREAD_POOL_FIBERS)
+            if (fibers && fibers->resume_ready())
+                continue;
+#endif
+
+            QueuedTask qt;
+
+            if (!try_pop_task(qt))
+            {
+#if defined(THREAD_POOL_FIBERS)
+                // suspended fibers may wait for tasks of other workers - they are polled while idle
+                if (fibers && fibers->has_suspended())
+                {
+                    if (!fibers->resume_ready(true))
+                        wait_for_tasks(options_.fiber_poll_interval, false);
+                    continue;
+                }
+#endif
+
+                if (is_shutdown_)
+                    break;
+
+                auto idle_start = steady_clock::now();
+                trace(details::TraceEventType::sleep);
+                bool has_tasks = wait_for_tasks(options_.keep_alive);
+                trace(details::TraceEventType::wake);
+                details::WorkerStats::increment(stats.idle_time_ns, (steady_clock::now() - idle_start).count());
+
+                if (!has_tasks && try_retire(worker_id, stats_slot))
+                    break;
+                continue;
+            }
+
+            auto start = steady_clock::now();
+
+            if (start - qt.enqueued > options_.spawn_wait_time && queued_tasks_ > 0)
+                try_spawn();
+
+#if defined(THREAD_POOL_FIBERS)
+            if (fibers)
+                fibers->run([this, &stats, qt = std::move(qt), start]() mutable {
+                    details::WorkerStats::increment(stats.busy_time_ns, run_task(qt, start).count());
+                });
+            else
+#endif
+                details::WorkerStats::increment(stats.busy_time_ns, run_task(qt, start).count());
+
+#if defined(__cpp_lib_memory_resource)
+            reset_arena();
+#endif
+
+            if (excess_threads_ > 0 && !has_suspended_fibers() && try_retire(worker_id, stats_slot, false))
+                break;
+        }
+
+        worker_exited();
+    }
+
+    void worker_exited()
+    {
+        flush_lifo();
+
+        std::lock_guard<std::mutex> lk{mtx_threads_};
+        --alive_workers_;
+        cv_worker_exited_.notify_all();
+    }
+
+    void wake_all_workers()
+    {
+        std::lock_guard<std::mutex> lk{mtx_idle_};
+
+        for(auto& node_queue : node_queues_)
+            node_queue->cv_tasks.notify_all();
+    }
+
+    // called with mtx_threads_ locked
+    void start_worker()
+    {
+        size_t id = next_worker_id_++;
+
+        size_t stats_slot = used_stats_slots_;
+        if (free_stats_slots_.empty())
+            ++used_stats_slots_;
+        else
+        {
+            stats_slot = free_stats_slots_.back();
+            free_stats_slots_.pop_back();
+        }
+
+        threads_.emplace(id, std::thread{[this, id, stats_slot] { run(id, stats_slot); }});
+        ++alive_workers_;
+    }
+
+    void task_finished(details::TaskStatus status)
+    {
+        if (status == details::TaskStatus::completed)
+            details::WorkerStats::increment(local_stats().tasks_completed);
+        else if (status == details::TaskStatus::failed)
+            details::WorkerStats::increment(local_stats().tasks_failed);
+        else if (status == details::TaskStatus::cancelled)
+            details::WorkerStats::increment(local_stats().tasks_cancelled);
+        else if (status == details::TaskStatus::rejected)
+            details::WorkerStats::increment(local_stats().tasks_rejected);
+    }
+
+    template <typename T>
+    struct PendingTask
+    {
+        Task task;
+        Task reject; // completes the future with TaskRejected instead of running the task
+        TaskFuture<T> future;
+    };
+
+    // wraps callable into a task that completes returned future
+    template <typename Callable>
+    auto make_task(Callable&& callable, ext::stop_token token = {})
+    {
+        using CallableT = std::decay_t<Callable>;
+        using ResultT = decltype(details::invoke_with_token(std::declval<CallableT&>(), token, 0));
+
+        auto pt = std::make_shared<details::PromiseTask<ResultT, CallableT>>(std::forward<Callable>(callable), std::move(token));
+        TaskFuture<ResultT> f{pt->get_future(), *this};
+
+        auto on_finished = [this](details::TaskStatus status) { task_finished(status); };
+
+        return PendingTask<ResultT>{
+            [pt, on_finished] { (*pt)(on_finished); },
+            [pt, on_finished] { pt->reject(on_finished); },
+            std::move(f)};
+    }
+
+    template <typename T>
+    TaskFuture<T> submit_task(PendingTask<T> pending_task, Priority priority = Priority::normal,
+                              std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max())
+    {
+        push_task(std::move(pending_task.task), priority, deadline, std::move(pending_task.reject));
+        return std::move(pending_task.future);
+    }
+
+    // called with mtx_threads_ locked
+    size_t thread_limit() const
+    {
+        return options_.max_threads + blocked_workers_;
+    }
+
+    // called with mtx_threads_ locked
+    void update_excess_threads()
+    {
+        excess_threads_ = threads_.size() > thread_limit() ? threads_.size() - thread_limit() : 0;
+    }
+
+    void try_spawn()
+    {
+        std::vector<std::thread> retired_threads;
+        {
+            std::lock_guard<std::mutex> lk{mtx_threads_};
+
+            if (is_stopping_ || threads_.size() >= thread_limit())
+                return;
+
+            start_worker();
+            ++threads_spawned_;
+
+            retired_threads.swap(retired_threads_);
+        }
+
+        for(auto& thd : retired_threads)
+            thd.join();
+    }
+
+    // idle worker is retired if the pool is above min_threads, busy one - if it is above the current limit
+    bool try_retire(size_t worker_id, size_t stats_slot, bool is_idle = true)
+    {
+        std::lock_guard<std::mutex> lk{mtx_threads_};
+
+        if (is_stopping_)
+            return false; // workers exit when the queue is drained
+
+        if (threads_.size() <= (is_idle ? options_.min_threads : thread_limit()))
+        {
+            update_excess_threads();
+            return false;
+        }
+
+        auto it = threads_.find(worker_id);
+        retired_threads_.push_back(std::move(it->second));
+        threads_.erase(it);
+        free_stats_slots_.push_back(stats_slot);
+        ++threads_retired_;
+        update_excess_threads();
+
+        return true;
+    }
+
+    bool enter_blocking()
+    {
+        if (!is_worker_thread())
+            return false;
+
+        {
+            std::lock_guard<std::mutex> lk{mtx_threads_};
+
+            if (blocked_workers_ == options_.max_blocking_threads)
+                return false;
+
+            ++blocked_workers_;
+        }
+
+        flush_lifo();
+
+        if (idle_workers_ == 0 && queued_tasks_ > 0)
+            try_spawn();
+
+        return true;
+    }
+
+    void leave_blocking()
+    {
+        std::lock_guard<std::mutex> lk{mtx_threads_};
+
+        --blocked_workers_;
+        update_excess_threads();
+    }
+
+    // timer thread is started on first use - returns false after shutdown
+    bool try_schedule(TimerWheel::Clock::time_point tp, std::chrono::nanoseconds period, std::function<void()> callback,
+                      std::function<void()> discard, TimerHandle& handle)
+    {
+        std::lock_guard<std::mutex> lk{mtx_timers_};
+
+        if (are_timers_stopped_)
+            return false;
+
+        if (!timers_)
+            timers_ = std::make_unique<TimerWheel>();
+
+        handle = timers_->schedule_at(tp, period, std::move(callback), std::move(discard));
+        return true;
+    }
+
+    // timer thread must not submit tasks to stopped pool - pending one-shot tasks are rejected
+    void stop_timers()
+    {
+        std::unique_ptr<TimerWheel> timers;
+        {
+            std::lock_guard<std::mutex> lk{mtx_timers_};
+            are_timers_stopped_ = true;
+            timers = std::move(timers_);
+        }
+        // timer thread is joined here - without the lock, its callbacks may still submit tasks
+    }
+
+    void task_submitted(Priority priority)
+    {
+        details::WorkerStats::increment(local_stats().tasks_submitted);
+        trace(details::TraceEventType::submit, static_cast<uint32_t>(priority));
+    }
+
+    // admission control applies only to tasks with futures (reject is set)
+    // - returns false if the task was refused after shutdown - a task with future is rejected through it
+    bool push_task(Task task, Priority priority = Priority::normal,
+                   std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(),
+                   Task reject = nullptr)
+    {
+        task_submitted(priority);
+        return push_submitted_task(std::move(task), priority, deadline, std::move(reject));
+    }
+
+    // task already counted by task_submitted() - e.g. delayed task counted when it was scheduled
+    bool push_submitted_task(Task task, Priority priority, std::chrono::steady_clock::time_point deadline, Task reject)
+    {
+        QueuedTask qt{std::move(task), std::chrono::steady_clock::now(), priority, deadline, std::move(reject)};
+
+        // after shutdown only running tasks may submit (continuations) - workers could have exited already
+        if (is_shutdown_ && !is_worker_thread())
+        {
+            if (qt.reject)
+                qt.reject();
+            else
+                task_finished(details::TaskStatus::rejected);
+            return false;
+        }
+
+        if (qt.reject && queued_tasks_ >= options_.max_queue_depth)
+        {
+            if (options_.overload_policy == OverloadPolicy::caller_runs)
+                run_task(qt, qt.enqueued);
+            else
+                qt.reject();
+            return true;
+        }
+
+        if (try_push_lifo(qt))
+            return true;
+
+        enqueue(std::move(qt), submit_node());
+
+        if (idle_workers_ == 0 && queued_tasks_ >= options_.spawn_queue_depth)
+            try_spawn();
+
+        return true;
+    }
+
+    static PoolOptions fixed_size_options(size_t size)
+    {
+        PoolOptions options;
+        options.min_threads = options.max_threads = size;
+        return options;
+    }
+
+    // min(n, max_threads) runner tasks sharing one state are queued with one lock of the queue & one lock of idle workers
+    // - cost of submission does not depend on n; runners claim indices, so the load is balanced
+    BulkFuture push_bulk(size_t n, std::function<void(size_t)> body)
+    {
+#if defined(__cpp_lib_memory_resource)
+        // a runner executes many indices - each of them releases its scratch memory like a separate task
+        if (!worker_arenas_.empty())
+            body = [body = std::move(body)](size_t index) {
+                ArenaScope arena_scope;
+                body(index);
+            };
+#endif
+
+        // runners are the tasks of the pool - failed indices are counted separately
+        auto state = std::make_shared<details::BulkState>(n, std::move(body), [this] {
+            details::WorkerStats::increment(local_stats().bulk_items_failed);
+        });
+
+        if (n == 0)
+            return BulkFuture{std::move(state), *this};
+
+        if (is_shutdown_ && !is_worker_thread())
+            throw TaskRejected{};
+
+        const size_t no_of_runners = std::min(n, options_.max_threads);
+
+        details::WorkerStats::increment(local_stats().tasks_submitted, no_of_runners);
+        trace(details::TraceEventType::submit, static_cast<uint32_t>(Priority::normal));
+
+        const size_t node = submit_node();
+        queued_tasks_ += no_of_runners;
+        node_queues_[node]->tasks.push_n(
+            QueuedTask{[this, state] {
+                           if (size_t cancelled = state->run_all(&is_cancelling_))
+                               details::WorkerStats::increment(local_stats().bulk_items_cancelled, cancelled);
+                       },
+                       std::chrono::steady_clock::now(), Priority::normal,
+                       std::chrono::steady_clock::time_point::max(), nullptr},
+            no_of_runners);
+
+        if (idle_workers_ > 0)
+            wake_workers(node, no_of_runners);
+
+        if (idle_workers_ == 0 && queued_tasks_ >= options_.spawn_queue_depth)
+            try_spawn();
+
+        return BulkFuture{std::move(state), *this};
+    }
+
+public:
+    ThreadPool(size_t size) : ThreadPool{fixed_size_options(size)}
+    {}
+
+    explicit ThreadPool(const PoolOptions& options)
+        : options_{options}, topology_{CpuTopology::detect()}, cpus_{placement_cpus()}
+    {
+        assert(options_.min_threads > 0 && options_.min_threads <= options_.max_threads);
+
+        const size_t no_of_nodes = cpus_.empty() ? 1 : topology_.nodes().size();
+        for(size_t i = 0; i < no_of_nodes; ++i)
+            node_queues_.push_back(std::make_unique<NodeQueue>(options_.aging_threshold));
+
+        if (options_.shed_target > std::chrono::milliseconds::zero())
+            shedding_ = std::make_unique<CoDel>(options_.shed_target, options_.shed_interval);
+
+        const size_t no_of_slots = options_.max_threads + options_.max_blocking_threads;
+
+        for(size_t i = 0; i < no_of_slots; ++i)
+        {
+            worker_stats_.push_back(std::make_unique<details::WorkerStats>());
+            lifo_slots_.push_back(std::make_unique<LifoSlot>());
+        }
+
+#if defined(__cpp_lib_memory_resource)
+        // interleaved fibers of a worker would allocate from its arena out of stack order - it could never be reset
+        if (options_.worker_arena_size > 0 && !uses_fibers())
+        {
+            for(size_t i = 0; i < no_of_slots; ++i)
+                worker_arenas_.push_back(std::make_unique<WorkerArena>(options_.worker_arena_size));
+        }
+#endif
+
+        if (options_.trace_buffer_size > 0)
+        {
+            for(size_t i = 0; i < no_of_slots; ++i)
+                worker_traces_.push_back(std::make_unique<details::TraceBuffer>(options_.trace_buffer_size));
+            external_trace_ = std::make_unique<details::TraceBuffer>(options_.trace_buffer_size);
+        }
+
+        std::lock_guard<std::mutex> lk{mtx_threads_};
+        for(size_t i = 0; i < options_.min_threads; ++i)
+            start_worker();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // fire & forget - exceptions must be handled by a task
+    // - throws TaskRejected after shutdown when called from outside of the pool
+    void execute(Task task)
+    {
+        assert(task != nullptr);
+
+        if (!push_task(std::move(task)))
+            throw TaskRejected{};
+    }
+
+    // fire & forget - returns false instead of throwing TaskRejected, the task is not run
+    // - used by wrappers (groups, strands, graphs) to undo their bookkeeping of the refused task
+    bool try_execute(Task task)
+    {
+        assert(task != nullptr);
+
+        return push_task(std::move(task));
+    }
+
+    // mass fan-out: tasks are run by a few runner tasks queued at once and tracked by a single BulkFuture
+    // - runners are not subject to admission control & LIFO slot
+    template <typename Range>
+    BulkFuture submit_bulk(Range&& callables)
+    {
+        std::vector<Task> tasks;
+        for(auto&& callable : callables)
+            tasks.emplace_back(std::forward<decltype(callable)>(callable));
+
+        const size_t n = tasks.size();
+        return push_bulk(n, [tasks = std::move(tasks)](size_t index) { tasks[index](); });
+    }
+
+    // runs f(0), f(1), ..., f(n - 1)
+    template <typename Function>
+    BulkFuture submit_n(size_t n, Function f)
+    {
+        return push_bulk(n, std::move(f));
+    }
+
+    // Executor interface (executor.hpp)
+    template <typename Function>
+    BulkFuture bulk_execute(size_t n, Function f)
+    {
+        return submit_n(n, std::move(f));
+    }
+
+    template <typename Callable>
+    auto submit(Callable&& callable)
+    {
+        return submit(Priority::normal, std::forward<Callable>(callable));
+    }
+
+    // workers take tasks of higher priority first - long waiting tasks are aged to avoid starvation
+    template <typename Callable>
+    auto submit(Priority priority, Callable&& callable)
+    {
+        return submit_task(make_task(std::forward<Callable>(callable)), priority);
+    }
+
+    // tasks with deadlines are taken before prioritized tasks - earliest deadline first
+    template <typename Callable>
+    auto submit(Deadline deadline, Callable&& callable)
+    {
+        return submit_task(make_task(std::forward<Callable>(callable)), Priority::high, deadline.time);
+    }
+
+    // task is dropped if stop is requested before it starts - its future throws TaskCancelled
+    // - callable may take ext::stop_token to poll for cancellation while running
+    template <typename Callable>
+    auto submit(ext::stop_token token, Callable&& callable)
+    {
+        return submit_task(make_task(std::forward<Callable>(callable), std::move(token)));
+    }
+
+    // task that blocks (I/O, sleep, waiting on external events) - runs in blocking_region()
+    template <typename Callable>
+    auto submit_blocking(Callable&& callable)
+    {
+        return submit([this, callable = std::forward<Callable>(callable)]() mutable {
+            auto region = blocking_region();
+            return callable();
+        });
+    }
+
+    // delayed task is held by the timer thread - no worker is blocked until it is due
+    // - returns DelayedFuture that can cancel the task before it is due
+    // - after shutdown (also for tasks still pending at shutdown) the future throws TaskRejected
+    // - counted as submitted at once, so every outcome (also cancellation before it is due) has its submission
+    template <typename Callable>
+    auto submit_at(TimerWheel::Clock::time_point tp, Callable&& callable)
+    {
+        ext::stop_source stop;
+        auto pending_task = make_task(std::forward<Callable>(callable), stop.get_token());
+        using ResultT = decltype(pending_task.future.get());
+
+        task_submitted(Priority::normal);
+
+        TimerHandle timer;
+        bool is_scheduled = try_schedule(tp, std::chrono::nanoseconds::zero(),
+                                         [this, task = pending_task.task, reject = pending_task.reject] {
+                                             push_submitted_task(task, Priority::normal, std::chrono::steady_clock::time_point::max(), reject);
+                                         },
+                                         pending_task.reject, timer);
+        if (!is_scheduled)
+            pending_task.reject();
+
+        return DelayedFuture<ResultT>{std::move(pending_task.future), std::move(timer), std::move(stop), std::move(pending_task.task)};
+    }
+
+    template <typename Rep, typename Period, typename Callable>
+    auto submit_after(const std::chrono::duration<Rep, Period>& delay, Callable&& callable)
+    {
+        return submit_at(TimerWheel::Clock::now() + delay, std::forward<Callable>(callable));
+    }
+
+    // periodic task - first run after one period; exceptions must be handled by a task
+    // - throws TaskRejected after shutdown
+    template <typename Rep, typename Period>
+    TimerHandle submit_every(const std::chrono::duration<Rep, Period>& period, Task task)
+    {
+        assert(task != nullptr);
+
+        TimerHandle timer;
+        if (!try_schedule(TimerWheel::Clock::now() + period, period, [this, task] { push_task(task); }, nullptr, timer))
+            throw TaskRejected{};
+
+        return timer;
+    }
+
+    // appends stats() as a line of JSON to the file every period
+    template <typename Rep, typename Period>
+    TimerHandle dump_stats_every(const std::chrono::duration<Rep, Period>& period, const std::string& path)
+    {
+        return submit_every(period, [this, path] {
+            std::ofstream out{path, std::ios::app};
+            stats().write(out);
+        });
+    }
+
+#if defined(__cpp_impl_coroutine)
+    // co_await pool.schedule() - resumes the coroutine in one of the workers
+    auto schedule()
+    {
+        struct ScheduleAwaiter
+        {
+            ThreadPool& pool;
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> coro)
+            {
+                pool.execute([coro] { coro.resume(); });
+            }
+
+            void await_resume() const noexcept
+            {}
+        };
+
+        return ScheduleAwaiter{*this};
+    }
+#endif
+
+    // Scope in which a worker blocks - the pool may start a compensating worker, so CPU-bound tasks keep running
+    // - compensating worker is spawned on demand (tasks waiting, no idle worker), up to max_blocking_threads
+    // - when the region ends, surplus worker is retired after its current task
+    // - no-op outside of workers of the pool
+    class BlockingRegion
+    {
+        ThreadPool* pool_;
+
+    public:
+        explicit BlockingRegion(ThreadPool& pool) : pool_{pool.enter_blocking() ? &pool : nullptr}
+        {}
+
+        BlockingRegion(BlockingRegion&& other) noexcept : pool_{std::exchange(other.pool_, nullptr)}
+        {}
+
+        BlockingRegion(const BlockingRegion&) = delete;
+        BlockingRegion& operator=(const BlockingRegion&) = delete;
+        BlockingRegion& operator=(BlockingRegion&&) = delete;
+
+        ~BlockingRegion()
+        {
+            if (pool_)
+                pool_->leave_blocking();
+        }
+    };
+
+    BlockingRegion blocking_region()
+    {
+        return BlockingRegion{*this};
+    }
+
+    // true if called from one of the workers of this pool
+    bool is_worker_thread() const
+    {
+        return current_pool() == this;
+    }
+
+    // runs one of the queued tasks in the calling thread
+    // - used by workers that wait for subtasks, so they never block the pool
+    bool try_run_pending_task()
+    {
+        QueuedTask qt;
+        if (!try_pop_task(qt))
+            return false;
+
+        run_task(qt, std::chrono::steady_clock::now());
+        return true;
+    }
+
+    // executes queued tasks in the calling worker until is_ready() returns true
+    // - with no task to run the worker sleeps until a task is queued, checking is_ready() every help_wait_interval
+    // - a worker holding a TaskMutex only waits in a blocking region - a helped task could wait for the same lock
+    // - in fiber mode the task is suspended instead - the worker continues with other tasks
+    template <typename Predicate>
+    void help_until(Predicate is_ready)
+    {
+        assert(is_worker_thread());
+
+#if defined(THREAD_POOL_FIBERS)
+        if (current_fibers() && current_fibers()->in_fiber())
+        {
+            if (!is_ready())
+                current_fibers()->suspend(is_ready);
+            return;
+        }
+#endif
+
+        auto& stats = *current_stats();
+        size_t failed_attempts = 0;
+        std::unique_ptr<BlockingRegion> lock_holder_region; // compensating worker runs the tasks instead
+
+        while (!is_ready())
+        {
+            QueuedTask qt;
+
+            if (held_task_locks() == 0 && try_pop_task(qt))
+            {
+                auto helping_time = run_task(qt, std::chrono::steady_clock::now());
+                details::WorkerStats::increment(stats.helping_time_ns, helping_time.count());
+                details::WorkerStats::increment(stats.helped_tasks);
+                failed_attempts = 0;
+            }
+            else if (++failed_attempts < help_spin_limit)
+                std::this_thread::yield();
+            else if (held_task_locks() > 0)
+            {
+                if (!lock_holder_region)
+                    lock_holder_region = std::make_unique<BlockingRegion>(*this);
+                std::this_thread::sleep_for(options_.help_wait_interval);
+            }
+            else
+                wait_for_tasks(options_.help_wait_interval, false);
+        }
+    }
+
+#if defined(__cpp_lib_memory_resource)
+    // scratch memory of the running task - released after the task when the worker takes the next one
+    // - outside of workers (or with disabled arenas, also in fiber mode) the default memory resource is returned
+    // - memory must not outlive the task: it cannot be passed to a result or to other tasks
+    static std::pmr::memory_resource* worker_arena()
+    {
+        WorkerArena* arena = current_arena();
+        return arena ? static_cast<std::pmr::memory_resource*>(arena) : std::pmr::get_default_resource();
+    }
+
+    // releases all memory of the worker arena before the end of the task
+    // - must not be called while memory of the arena is used, also by a task that waits for this one
+    static void reset_worker_arena()
+    {
+        reset_arena();
+    }
+#endif
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lk{mtx_threads_};
+        return threads_.size();
+    }
+
+    // counters are read without stopping workers - a snapshot may be slightly inconsistent
+    // - outcome of a task with a future (completed, failed, ...) is counted before the future becomes ready
+    // - histograms & per-worker counters are updated after the task returns
+    PoolStats stats() const
+    {
+        PoolStats s;
+        external_stats_.add_to(s);
+
+        size_t used_stats_slots;
+        {
+            std::lock_guard<std::mutex> lk{mtx_threads_};
+            s.threads = threads_.size();
+            used_stats_slots = used_stats_slots_;
+        }
+
+        for(size_t i = 0; i < used_stats_slots; ++i)
+        {
+            worker_stats_[i]->add_to(s);
+            s.workers.push_back(worker_stats_[i]->snapshot());
+        }
+
+        s.threads_spawned = threads_spawned_.load();
+        s.threads_retired = threads_retired_.load();
+        return s;
+    }
+
+    // recorded events in Chrome Trace Event format - open in chrome://tracing or ui.perfetto.dev
+    // - a track per worker slot (reused by workers spawned after retirement) and one for external threads
+    void write_trace(std::ostream& out) const
+    {
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+        if (options_.trace_buffer_size > 0)
+        {
+            bool is_first = true;
+
+            details::write_trace_events(out, *external_trace_, 0, "external threads", trace_start_, is_first);
+
+            size_t used_stats_slots;
+            {
+                std::lock_guard<std::mutex> lk{mtx_threads_};
+                used_stats_slots = used_stats_slots_;
+            }
+
+            for(size_t i = 0; i < used_stats_slots; ++i)
+            {
+                std::string name = "worker#" + std::to_string(i);
+                details::write_trace_events(out, *worker_traces_[i], i + 1, name.c_str(), trace_start_, is_first);
+            }
+        }
+
+        out << "\n]}\n";
+    }
+
+    // stops the pool and joins workers - must not be called from a task of the pool
+    // - after shutdown submit() from outside of the pool returns rejected future, execute() throws TaskRejected
+    // - delayed tasks not yet due are rejected, periodic tasks are discarded
+    // - on cancellation fire & forget tasks still run (continuations of groups, strands...), but runners of
+    //   submit_bulk() / submit_n() stop taking new indices
+    void shutdown(ShutdownMode mode = ShutdownMode::drain)
+    {
+        begin_shutdown(mode);
+        wait_for_workers(std::chrono::steady_clock::time_point::max());
+        join_workers();
+    }
+
+    // drains the queue until the timeout, then cancels pending tasks - running tasks are always finished
+    // - returns true if all tasks were executed before the timeout
+    template <typename Rep, typename Period>
+    bool shutdown_for(const std::chrono::duration<Rep, Period>& timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        begin_shutdown(ShutdownMode::drain);
+        bool is_drained = wait_for_workers(deadline);
+
+        if (!is_drained)
+        {
+            is_cancelling_ = true;
+            wake_all_workers();
+            wait_for_workers(std::chrono::steady_clock::time_point::max());
+        }
+
+        join_workers();
+        return is_drained;
+    }
+
+    ~ThreadPool()
+    {
+        shutdown(ShutdownMode::drain);
+    }
+
+private:
+    void begin_shutdown(ShutdownMode mode)
+    {
+        assert(!is_worker_thread());
+
+        bool is_first_call;
+        {
+            std::lock_guard<std::mutex> lk{mtx_threads_};
+            is_first_call = !std::exchange(is_stopping_, true);
+        }
+
+        if (is_first_call)
+            stop_timers();
+
+        if (mode == ShutdownMode::cancel_pending)
+            is_cancelling_ = true;
+        is_shutdown_ = true;
+
+        wake_all_workers();
+    }
+
+    // returns false on timeout
+    bool wait_for_workers(std::chrono::steady_clock::time_point deadline)
+    {
+        std::unique_lock<std::mutex> lk{mtx_threads_};
+
+        if (deadline == std::chrono::steady_clock::time_point::max())
+        {
+            cv_worker_exited_.wait(lk, [this] { return alive_workers_ == 0; });
+            return true;
+        }
+
+        return cv_worker_exited_.wait_until(lk, deadline, [this] { return alive_workers_ == 0; });
+    }
+
+    void join_workers()
+    {
+        std::map<size_t, std::thread> threads;
+        std::vector<std::thread> retired_threads;
+        {
+            std::lock_guard<std::mutex> lk{mtx_threads_};
+            threads.swap(threads_);
+            retired_threads.swap(retired_threads_);
+        }
+
+        for(auto& thd : threads)
+            thd.second.join();
+
+        for(auto& thd : retired_threads)
+            thd.join();
+    }
+};
+
+template <typename T>
+void TaskFuture<T>::wait() const
+{
+    if (pool_ && pool_->is_worker_thread())
+        pool_->help_until([this] { return is_ready(); });
+
+    future_.wait();
+}
+
+inline void BulkFuture::wait() const
+{
+    if (pool_ && pool_->is_worker_thread())
+        pool_->help_until([this] { return is_ready(); });
+
+    state_->wait();
+}
+
+#endif // THREAD_POOL_HPP
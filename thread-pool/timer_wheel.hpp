@@ -0,0 +1,321 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TimerWheel;
+
+namespace details
+{
+    struct TimerEntry;
+    using TimerSlot = std::list<std::shared_ptr<TimerEntry>>;
+
+    // shared by a wheel & handles of its timers - wheel is null after the wheel is destroyed
+    struct TimerWheelState
+    {
+        std::mutex mtx; // guards the wheel
+        TimerWheel* wheel;
+    };
+
+    struct TimerEntry
+    {
+        uint64_t expiry_tick;
+        uint64_t period_ticks; // 0 - one-shot timer
+        std::function<void()> callback;
+        std::function<void()> discard; // called if the wheel is destroyed before one-shot timer fires
+        TimerSlot* slot = nullptr;
+        TimerSlot::iterator position;
+    };
+}
+
+// allows to cancel a scheduled timer - also concurrently with destruction of the wheel
+class TimerHandle
+{
+    std::weak_ptr<details::TimerEntry> entry_;
+    std::shared_ptr<details::TimerWheelState> wheel_state_;
+
+public:
+    TimerHandle() = default;
+
+    TimerHandle(std::weak_ptr<details::TimerEntry> entry, std::shared_ptr<details::TimerWheelState> wheel_state)
+        : entry_{std::move(entry)}, wheel_state_{std::move(wheel_state)}
+    {}
+
+    // returns false if timer has already fired (one-shot), was cancelled or its wheel was destroyed
+    bool cancel();
+};
+
+// Hierarchical timing wheel serviced by a single timer thread
+// - 4 levels of 64 slots - O(1) insertion & cancellation
+// - timers from upper levels are cascaded down when the lower level wraps around
+// - callbacks are called in the timer thread, so they should only hand the work over (e.g. to a thread pool)
+class TimerWheel
+{
+    friend class TimerHandle;
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    static constexpr size_t slot_bits = 6;
+    static constexpr size_t slots_per_level = 1 << slot_bits;
+    static constexpr size_t levels = 4;
+    static constexpr uint64_t max_delay_ticks = (uint64_t{1} << (slot_bits * levels)) - 1;
+
+    using Level = std::array<details::TimerSlot, slots_per_level>;
+
+    const std::chrono::nanoseconds resolution_;
+    const Clock::time_point origin_;
+    std::array<Level, levels> wheel_;
+    uint64_t current_tick_ = 0;
+    size_t no_of_timers_ = 0;
+    bool is_stopped_ = false;
+    const std::shared_ptr<details::TimerWheelState> state_;
+    std::condition_variable cv_;
+    std::thread timer_thread_;
+
+    // rounded up - timer never fires too early
+    uint64_t expiry_tick_of(Clock::time_point tp) const
+    {
+        if (tp <= origin_)
+            return 0;
+
+        return (std::chrono::duration_cast<std::chrono::nanoseconds>(tp - origin_) + resolution_ - std::chrono::nanoseconds{1}) / resolution_;
+    }
+
+    // rounded down - number of ticks that have fully elapsed
+    uint64_t elapsed_ticks(Clock::time_point now) const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now - origin_) / resolution_;
+    }
+
+    Clock::time_point time_of(uint64_t tick) const
+    {
+        return origin_ + std::chrono::duration_cast<Clock::duration>(resolution_ * tick);
+    }
+
+    // called with state_->mtx locked
+    void insert(const std::shared_ptr<details::TimerEntry>& entry)
+    {
+        uint64_t expiry_tick = std::max(entry->expiry_tick, current_tick_ + 1);
+        uint64_t delay = expiry_tick - current_tick_;
+
+        if (delay > max_delay_ticks)
+            expiry_tick = current_tick_ + max_delay_ticks; // re-inserted when cascaded down
+
+        size_t level = 0;
+        while (level < levels - 1 && delay >= (uint64_t{1} << (slot_bits * (level + 1))))
+            ++level;
+
+        auto& slot = wheel_[level][(expiry_tick >> (slot_bits * level)) & (slots_per_level - 1)];
+        entry->slot = &slot;
+        entry->position = slot.insert(slot.end(), entry);
+    }
+
+    // called with state_->mtx locked
+    void unlink(details::TimerEntry& entry)
+    {
+        entry.slot->erase(entry.position);
+        entry.slot = nullptr;
+    }
+
+    // called with state_->mtx locked - moves wheel up to the tick and collects expired callbacks
+    void advance(uint64_t tick, std::vector<std::function<void()>>& expired)
+    {
+        if (no_of_timers_ == 0)
+        {
+            current_tick_ = std::max(current_tick_, tick);
+            return;
+        }
+
+        while (current_tick_ < tick)
+        {
+            ++current_tick_;
+
+            // cascading timers from upper levels
+            for(size_t level = 1; level < levels; ++level)
+            {
+                if ((current_tick_ & ((uint64_t{1} << (slot_bits * level)) - 1)) != 0)
+                    break;
+
+                auto& slot = wheel_[level][(current_tick_ >> (slot_bits * level)) & (slots_per_level - 1)];
+                details::TimerSlot cascaded;
+                cascaded.swap(slot);
+
+                for(auto& entry : cascaded)
+                    insert(entry);
+            }
+
+            auto& slot = wheel_[0][current_tick_ & (slots_per_level - 1)];
+            details::TimerSlot due;
+            due.swap(slot);
+
+            for(auto& entry : due)
+            {
+                if (entry->expiry_tick > current_tick_)
+                {
+                    insert(entry);
+                    continue;
+                }
+
+                expired.push_back(entry->callback);
+
+                if (entry->period_ticks > 0)
+                {
+                    entry->expiry_tick += entry->period_ticks;
+                    insert(entry);
+                }
+                else
+                {
+                    entry->slot = nullptr;
+                    --no_of_timers_;
+                }
+            }
+        }
+    }
+
+    // called with state_->mtx locked - next tick with a due timer or a cascade of upper levels
+    uint64_t next_wakeup_tick() const
+    {
+        uint64_t tick = current_tick_ + 1;
+
+        for(; (tick & (slots_per_level - 1)) != 0; ++tick)
+        {
+            if (!wheel_[0][tick & (slots_per_level - 1)].empty())
+                return tick;
+        }
+
+        return tick;
+    }
+
+    void run()
+    {
+        std::vector<std::function<void()>> expired;
+
+        std::unique_lock<std::mutex> lk{state_->mtx};
+
+        while (!is_stopped_)
+        {
+            advance(elapsed_ticks(Clock::now()), expired);
+
+            if (!expired.empty())
+            {
+                lk.unlock();
+
+                for(auto& callback : expired)
+                    callback();
+                expired.clear();
+
+                lk.lock();
+                continue;
+            }
+
+            if (no_of_timers_ == 0)
+                cv_.wait(lk);
+            else
+                cv_.wait_until(lk, time_of(next_wakeup_tick()));
+        }
+    }
+
+public:
+    explicit TimerWheel(std::chrono::nanoseconds resolution = std::chrono::milliseconds{1})
+        : resolution_{resolution}, origin_{Clock::now()}, state_{std::make_shared<details::TimerWheelState>()}
+    {
+        state_->wheel = this;
+        timer_thread_ = std::thread{[this] { run(); }};
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // pending one-shot timers are discarded - their discard callbacks are called
+    ~TimerWheel()
+    {
+        {
+            std::lock_guard<std::mutex> lk{state_->mtx};
+            is_stopped_ = true;
+        }
+        cv_.notify_one();
+
+        timer_thread_.join();
+
+        std::vector<std::function<void()>> discarded;
+        {
+            std::lock_guard<std::mutex> lk{state_->mtx};
+            state_->wheel = nullptr; // handles cannot cancel anymore
+
+            for(auto& level : wheel_)
+                for(auto& slot : level)
+                    for(auto& entry : slot)
+                    {
+                        entry->slot = nullptr;
+                        if (entry->period_ticks == 0 && entry->discard)
+                            discarded.push_back(std::move(entry->discard));
+                    }
+        }
+
+        for(auto& discard : discarded)
+            discard();
+    }
+
+    // period == 0 - one-shot timer
+    TimerHandle schedule_at(Clock::time_point tp, std::chrono::nanoseconds period, std::function<void()> callback,
+                            std::function<void()> discard = nullptr)
+    {
+        auto entry = std::make_shared<details::TimerEntry>();
+        entry->period_ticks = std::max<uint64_t>(period / resolution_, period.count() > 0 ? 1 : 0);
+        entry->callback = std::move(callback);
+        entry->discard = std::move(discard);
+
+        {
+            std::lock_guard<std::mutex> lk{state_->mtx};
+            entry->expiry_tick = expiry_tick_of(tp);
+            insert(entry);
+            ++no_of_timers_;
+        }
+        cv_.notify_one();
+
+        return TimerHandle{entry, state_};
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lk{state_->mtx};
+        return no_of_timers_;
+    }
+
+private:
+    // called with state_->mtx locked
+    bool cancel(details::TimerEntry& entry)
+    {
+        if (entry.slot == nullptr)
+            return false;
+
+        unlink(entry);
+        --no_of_timers_;
+
+        return true;
+    }
+};
+
+inline bool TimerHandle::cancel()
+{
+    auto entry = entry_.lock();
+
+    if (!entry)
+        return false;
+
+    std::lock_guard<std::mutex> lk{wheel_state_->mtx};
+    return wheel_state_->wheel != nullptr && wheel_state_->wheel->cancel(*entry);
+}
+
+#endif // TIMER_WHEEL_HPP
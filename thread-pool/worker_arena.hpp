@@ -0,0 +1,139 @@
+#ifndef WORKER_ARENA_HPP
+#define WORKER_ARENA_HPP
+
+// std::pmr requires C++17 - WorkerArena is not available in C++14 builds
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <memory_resource>
+#endif
+
+#if defined(__cpp_lib_memory_resource)
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Monotonic arena of one worker - allocation bumps a pointer, deallocation is a no-op
+// - reset() releases all allocations at once and keeps the memory for the next task
+// - used only by its worker, so it is not thread-safe
+class WorkerArena : public std::pmr::memory_resource
+{
+    struct Chunk
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    const size_t initial_size_;
+    std::vector<Chunk> chunks_;
+    size_t current_ = 0; // index of chunk being filled
+    size_t offset_ = 0;  // used bytes of current chunk
+    size_t used_ = 0;
+
+    void add_chunk(size_t min_size)
+    {
+        size_t size = std::max(chunks_.empty() ? initial_size_ : 2 * chunks_.back().size, min_size);
+        chunks_.push_back(Chunk{std::make_unique<std::byte[]>(size), size});
+    }
+
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        while (true)
+        {
+            if (current_ < chunks_.size())
+            {
+                Chunk& chunk = chunks_[current_];
+
+                void* ptr = chunk.data.get() + offset_;
+                size_t space = chunk.size - offset_;
+
+                if (std::align(alignment, bytes, ptr, space))
+                {
+                    size_t end = static_cast<size_t>(static_cast<std::byte*>(ptr) - chunk.data.get()) + bytes;
+                    used_ += end - offset_;
+                    offset_ = end;
+                    return ptr;
+                }
+
+                if (current_ + 1 < chunks_.size())
+                {
+                    ++current_;
+                    offset_ = 0;
+                    continue;
+                }
+            }
+
+            add_chunk(bytes + alignment);
+            current_ = chunks_.size() - 1;
+            offset_ = 0;
+        }
+    }
+
+    void do_deallocate(void*, size_t, size_t) override
+    {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+public:
+    // position in the arena - see rewind()
+    struct Mark
+    {
+        size_t chunk;
+        size_t offset;
+        size_t used;
+    };
+
+    explicit WorkerArena(size_t initial_size) : initial_size_{std::max<size_t>(initial_size, 1)}
+    {}
+
+    // bytes allocated since the last reset (including alignment padding)
+    size_t used() const noexcept
+    {
+        return used_;
+    }
+
+    // memory kept by the arena
+    size_t capacity() const noexcept
+    {
+        size_t capacity = 0;
+        for(const auto& chunk : chunks_)
+            capacity += chunk.size;
+        return capacity;
+    }
+
+    Mark mark() const noexcept
+    {
+        return Mark{current_, offset_, used_};
+    }
+
+    // memory allocated after the mark becomes invalid - chunks are kept, so it is reused by next allocations
+    void rewind(const Mark& mark) noexcept
+    {
+        current_ = mark.chunk;
+        offset_ = mark.offset;
+        used_ = mark.used;
+    }
+
+    // all memory allocated from the arena becomes invalid
+    // - chunks of a task that outgrew the first one are merged, so the next such task fits in one chunk
+    void reset()
+    {
+        if (current_ > 0)
+        {
+            size_t size = capacity();
+            chunks_.clear();
+            add_chunk(size);
+        }
+
+        current_ = 0;
+        offset_ = 0;
+        used_ = 0;
+    }
+};
+
+#endif
+
+#endif // WORKER_ARENA_HPP